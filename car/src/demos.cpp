@@ -6,10 +6,15 @@
 
 #include <atomic>
 #include <chrono>
+#include <cstdint>
+#include <cstdio>
 #include <cstdlib>
+#include <functional>
 #include <future>
 #include <iostream>
 #include <memory>
+#include <span>
+#include <string>
 #include <thread>
 
 #include <driver/device.hpp>
@@ -18,6 +23,8 @@
 #include <driver/motors.hpp>
 #include <driver/pinmap.hpp>
 #include <driver/servo.hpp>
+#include <shared/airv2.hpp>
+#include <shared/framecheck.hpp>
 #include <shared/menu.hpp>
 #include <shared/messages.hpp>
 #include <shared/tdma.hpp>
@@ -33,6 +40,9 @@ static void manual_drive_wasd();
 static void simple_lines();
 static void message_worker_test();
 static void turning();
+static void fec_benchmark();
+
+static constexpr uint32_t FEC_ITERATIONS = 20000;
 
 static const std::vector<menu_item> demos = {
 	{.text = "TDMA slots", .action = &tdma_slots},
@@ -41,6 +51,7 @@ static const std::vector<menu_item> demos = {
 	{.text = "Simple line following", .action = &simple_lines},
 	{.text = "Message worker", .action = &message_worker_test},
 	{.text = "Turning", .action = &turning},
+	{.text = "FEC benchmark", .action = &fec_benchmark},
 	{.text = "Simple line following", .action = &simple_lines}};
 
 void demo_submenu() {
@@ -152,9 +163,15 @@ void tdma_slots() {
 		} else {
 			std::cout << "No response" << '\n';
 		}
+
+		printf("Wake-up error: TX %.3f ms, RX %.3f ms\n",
+			(double)tdma_slot.get_tx_wake_error().count() / 1e6,
+			(double)tdma_slot.get_rx_wake_error().count() / 1e6);
 	}
 
 	restore_tty();
+	tdma_slot.print_timing(stdout);
+	prompt_enter();
 }
 
 void manual_drive() {
@@ -481,11 +498,41 @@ void message_worker_test() {
 		}
 	}
 
-	auto tdma_slot = std::make_shared<tdma>(rf_module, slot, selected_scheme);
+	// Control beacon needs 20 ms spec timeslots
+	tdma::timing_mode mode = tdma::LEGACY;
+	std::cout << "Use control beacon? (y/N): ";
+	std::getline(std::cin, input);
+	if (input == "y" || input == "Y") {
+		mode = tdma::SPEC_BEACON;
+		std::cout << "Request a slot from control? (y/N): ";
+		std::getline(std::cin, input);
+		if (input == "y" || input == "Y") {
+			mode = tdma::SPEC_DYNAMIC;
+		}
+	}
+
+	auto tdma_slot =
+		std::make_shared<tdma>(rf_module, slot, selected_scheme, mode);
 	tdma_slot->rx_set_offset(tdma_profile->rx_offset_ms);
 	tdma_slot->tx_set_offset(tdma_profile->tx_offset_ms);
 
-	message_worker worker(tdma_slot);
+	std::shared_ptr<tdma> beacon_slot = nullptr;
+	if (mode != tdma::LEGACY) {
+		beacon_slot = std::make_shared<tdma>(rf_module,
+			tdma::beacon_slot(selected_scheme), selected_scheme, mode);
+		beacon_slot->rx_set_offset(tdma_profile->rx_offset_ms);
+	}
+
+	message_worker worker(tdma_slot, beacon_slot);
+	auto turn_profile = car_profile.get_turn();
+	if (turn_profile.has_value()) {
+		worker.set_turn_times({
+			.right = std::chrono::milliseconds(
+				turn_profile->right_delay_ms + turn_profile->right_ms),
+			.left = std::chrono::milliseconds(
+				turn_profile->left_delay_ms + turn_profile->left_ms),
+		});
+	}
 
 	std::cout << "Enter the desired position: \n";
 	std::getline(std::cin, input);
@@ -500,9 +547,21 @@ void message_worker_test() {
 	}
 	std::cout << "Control Id: " << control_id.value() << std::endl;
 
+	const auto &sync = message_worker::get_clock_sync();
+	printf("Slot clock correction: %.3f ms, drift: %.2f ppm\n",
+		(double)sync.get_correction().count() / 1e6, sync.get_drift_ppm());
+
 	std::cout << "Sending request to " << desired_pos << " ...\n";
 	message_worker::command command = worker.send_request(desired_pos);
 
+	// Go for waiting cars only comes in the beacon
+	if (command == message_worker::SBY) {
+		std::cout << "STANDBY, waiting for go...\n";
+		if (worker.await_go(airv2::STANDBY_BEACONS)) {
+			command = message_worker::GRQ;
+		}
+	}
+
 	std::this_thread::sleep_for(std::chrono::milliseconds(10));
 
 	worker.send_clear();
@@ -587,3 +646,103 @@ void turning() {
 	restore_tty();
 	prompt_enter();
 }
+
+/**
+ * @brief Time frame coding work against the airtime of a retry.
+ *
+ */
+void fec_benchmark() {
+	auto request = airv2::make(airv2::REQUEST, 0, 0, airv2::positions(1, 3));
+	airv2::set_id(request, "BENCH-CAR");
+	const std::string frames[] = {"ACK", airv2::encode(request)};
+
+	// Average time per call, the result feeds a volatile so it is not elided
+	volatile uint32_t sink = 0;
+	auto measure = [&sink](const std::function<uint32_t()> &work) {
+		auto start = std::chrono::steady_clock::now();
+		for (uint32_t i = 0; i < FEC_ITERATIONS; i++) {
+			sink = sink + work();
+		}
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+				   std::chrono::steady_clock::now() - start) /
+			   FEC_ITERATIONS;
+	};
+
+	std::chrono::nanoseconds crc_cost(0);
+	std::chrono::nanoseconds fec_cost(0);
+	for (const auto &msg : frames) {
+		auto crc_frame = seal_frame(msg, FRAME_CRC);
+		crc_frame.resize(rf_transport::FRAME_SIZE);
+		auto fec_frame = seal_frame(msg, FRAME_FEC);
+		auto damaged = fec_frame;
+		damaged[2] ^= 0x5A;
+
+		auto crc_seal = measure([&msg]() {
+			return (uint32_t)seal_frame(msg, FRAME_CRC).length();
+		});
+		auto crc_check = measure([&crc_frame]() {
+			return (uint32_t)check_frame(
+				{reinterpret_cast<const uint8_t *>(crc_frame.data()),
+					crc_frame.length()});
+		});
+		auto fec_seal = measure([&msg]() {
+			return (uint32_t)seal_frame(msg, FRAME_FEC).length();
+		});
+		auto fec_check = measure([&fec_frame]() {
+			auto copy = fec_frame;
+			return (uint32_t)repair_frame(
+				{reinterpret_cast<uint8_t *>(copy.data()), copy.length()});
+		});
+		auto fec_repair = measure([&damaged]() {
+			auto copy = damaged;
+			return (uint32_t)repair_frame(
+				{reinterpret_cast<uint8_t *>(copy.data()), copy.length()});
+		});
+
+		bool binary = airv2::is_airv2(
+			{reinterpret_cast<const uint8_t *>(msg.data()), msg.length()});
+		printf("%s frame:\n", binary ? "AIRv2" : "ASCII");
+		printf("  CRC seal %6lld ns, check %6lld ns\n",
+			(long long)crc_seal.count(), (long long)crc_check.count());
+		printf("  FEC seal %6lld ns, check %6lld ns, repair %6lld ns\n",
+			(long long)fec_seal.count(), (long long)fec_check.count(),
+			(long long)fec_repair.count());
+
+		crc_cost = std::max(crc_cost, crc_seal + crc_check);
+		fec_cost = std::max(fec_cost, fec_seal + fec_repair);
+	}
+
+#ifdef __ARM_ARCH
+	printf("Target: ARMv%d\n", __ARM_ARCH);
+#else
+	printf("Target: not ARM, run on the car for ARMv6 figures\n");
+#endif
+
+	// A lost reply is retried after the message timeout of 4 TDMA frames
+	auto extra = std::max(fec_cost - crc_cost, std::chrono::nanoseconds(1));
+	auto airtime =
+		rf_transport::frame_airtime(drf7020d20::rate_bps(drf7020d20::DR9600));
+	printf("Extra FEC work per frame: %lld ns, frame airtime at 9600 bps: "
+		   "%lld us (%.3f%% of it)\n",
+		(long long)extra.count(),
+		(long long)std::chrono::duration_cast<std::chrono::microseconds>(
+			airtime)
+			.count(),
+		100.0 * (double)extra.count() / (double)airtime.count());
+	const char *scheme_names[] = {"A", "B", "C"};
+	for (auto mode : {tdma::LEGACY, tdma::SPEC}) {
+		for (auto div : {tdma::AIR_A, tdma::AIR_B, tdma::AIR_C}) {
+			const auto &table = tdma::get_table(div, mode);
+			auto retry = table.frame_duration * 4;
+			printf("AIR %s %s: retry costs %lld ms, FEC pays off above 1 "
+				   "byte error in %lld frames\n",
+				scheme_names[div], mode == tdma::SPEC ? "20 ms" : "50 ms",
+				(long long)std::chrono::duration_cast<
+					std::chrono::milliseconds>(retry)
+					.count(),
+				(long long)(retry / extra));
+		}
+	}
+
+	prompt_enter();
+}
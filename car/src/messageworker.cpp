@@ -4,35 +4,85 @@
  */
 #include "messageworker.hpp"
 
+#include <array>
 #include <functional>
 #include <sstream>
 #include <stdexcept>
 
+#include <shared/airv2.hpp>
+#include <shared/clocksync.hpp>
+#include <shared/contention.hpp>
 #include <shared/messages.hpp>
+#include <shared/slotclock.hpp>
 
-static constexpr std::string MSG_HEADER = "AIRv1.0";
 static constexpr std::string CHECK = "CHK";
 static constexpr std::string ACKNOWLEDGE = "ACK";
 static constexpr std::string STANDBY = "SBY";
 static constexpr std::string GO_REQUESTED = "GRQ";
 static constexpr std::string CLEAR = "CLR";
 
-static std::string format_checkin();
+static std::string format_checkin(protocol_version version);
 
 static constexpr uint8_t MESSAGE_TIMEOUT =
 	4; /*time to wait for message (in frames)*/
+static constexpr uint32_t CHECKIN_TRIES =
+	2; /*AIRv2 check ins before assuming AIRv1.0 control*/
 
-message_worker::message_worker(const std::shared_ptr<tdma> &tdma_handler_in)
+message_worker::message_worker(const std::shared_ptr<tdma> &tdma_handler_in,
+	const std::shared_ptr<tdma> &beacon_in)
 	: tdma_handler(tdma_handler_in),
+	  beacon(beacon_in),
 	  car_id(get_id()),
-	  current_pos(tdma_handler->get_timeslot()) {}
+	  current_pos(tdma_handler->get_timeslot()),
+	  arq(tdma_handler_in) {}
 
 std::optional<std::string> message_worker::send_checkin() {
-	tdma_handler->tx_sync(format_checkin()); // send check in
+	// Check in happens in whatever slot control hands out
+	bool dynamic =
+		beacon != nullptr && beacon->get_timing_table().has_contention;
+	if (dynamic &&
+		!request_slot(*tdma_handler, *beacon, current_pos).has_value()) {
+		return std::nullopt;
+	}
 
-	std::string control_id;
+	// Lost frames or being out of range must not give up AIRv2 for good
+	version = AIRV2;
+	auto msg = arq.check_in(format_checkin(version), CHECKIN_TRIES);
+	if (msg.has_value()) {
+		get_clock_sync().update(
+			airv2::unpack_offset(msg->arg), arq.get_last_sent());
+		std::array<char, airv2::MAX_ID_LENGTH> control_id;
+		return std::string(control_id.data(), airv2::get_id(*msg, control_id));
+	}
 
-	control_id = tdma_handler->rx_sync(MESSAGE_TIMEOUT); // receive check in
+	// Control granted the slot, so it speaks AIRv2 and the check in got lost
+	if (dynamic) {
+		return std::nullopt;
+	}
+
+	// AIRv1.0 control stations ignore headers they do not know, this
+	// session only
+	version = AIRV1;
+
+	tdma_handler->tx_sync(format_checkin(version)); // send check in
+	auto sent_at = slot_clock::clock::now();
+
+	rf_transport::frame reply;
+	if (!tdma_handler->rx_sync(reply, MESSAGE_TIMEOUT)) { // receive check in
+		return std::nullopt;
+	}
+
+	std::string control_id(reply.view());
+
+	// Older control stations do not report an offset
+	auto split = control_id.rfind(' ');
+	if (split != std::string::npos) {
+		auto error = parse_offset(control_id.substr(split + 1));
+		if (error.has_value()) {
+			get_clock_sync().update(*error, sent_at);
+		}
+		control_id.resize(split);
+	}
 
 	if (!validate_id(control_id)) {
 		return std::nullopt;
@@ -41,35 +91,87 @@ std::optional<std::string> message_worker::send_checkin() {
 	return control_id;
 }
 
+clock_sync &message_worker::get_clock_sync() {
+	// One slot clock per process, so one tracker too
+	static clock_sync sync; // NOLINT
+	return sync;
+}
+
 #include <iostream>
 
 message_worker::command message_worker::send_request(uint8_t desired_pos) {
+	if (version == AIRV2) {
+		auto command = request_command(desired_pos);
+		if (!command.has_value()) {
+			throw std::invalid_argument("Unsupported");
+		}
+
+		send_acknowledge();
+		return *command;
+	}
+
 	tdma_handler->tx_sync(format_request(desired_pos));
-	std::string command;
+	std::optional<message_worker::command> command;
 	uint32_t iterator = 0;
 
-	while (iterator < 3) {
+	while (iterator < 3 && !command.has_value()) {
 		iterator++;
+		command = receive_command();
+	}
 
-		std::string response =
-			tdma_handler->rx_sync(MESSAGE_TIMEOUT); // receive check in
+	send_acknowledge();
 
-		std::istringstream parts(response);
-		std::string ack;
+	if (!command.has_value()) {
+		throw std::invalid_argument("Unsupported");
+	}
 
-		parts >> ack;
-		if (parts.eof() || ack != ACKNOWLEDGE) {
-			continue;
-		}
-		parts >> command;
-		if (!parts.eof()) {
-			continue;
-		}
+	return *command;
+}
 
-		break;
+std::optional<message_worker::command> message_worker::request_command(
+	uint8_t desired_pos) {
+	auto request = airv2::make(
+		airv2::REQUEST, 0, 0, airv2::positions(current_pos, desired_pos));
+	if (turn_times.has_value()) {
+		airv2::set_turn_times(request, *turn_times);
 	}
 
-	tdma_handler->tx_sync(ACKNOWLEDGE);
+	auto msg = arq.request(request, airv2::COMMAND);
+	if (!msg.has_value()) {
+		return std::nullopt;
+	}
+
+	// Feedback is about the attempt that got through
+	get_clock_sync().update(airv2::get_feedback(*msg), arq.get_last_sent());
+
+	switch (msg->arg) {
+	case airv2::STANDBY:
+		return SBY;
+	case airv2::GO_REQUESTED:
+		return GRQ;
+	default:
+		return std::nullopt;
+	}
+}
+
+std::optional<message_worker::command> message_worker::receive_command() {
+	rf_transport::frame response;
+	if (!tdma_handler->rx_sync(response, MESSAGE_TIMEOUT)) {
+		return std::nullopt;
+	}
+
+	std::istringstream parts{std::string(response.view())};
+	std::string ack;
+	std::string command;
+
+	parts >> ack;
+	if (parts.eof() || ack != ACKNOWLEDGE) {
+		return std::nullopt;
+	}
+	parts >> command;
+	if (!parts.eof()) {
+		return std::nullopt;
+	}
 
 	std::cout << command << std::endl;
 	if (command == STANDBY) {
@@ -80,19 +182,59 @@ message_worker::command message_worker::send_request(uint8_t desired_pos) {
 		return GRQ;
 	}
 
-	throw std::invalid_argument("Unsupported");
+	return std::nullopt;
+}
+
+bool message_worker::await_go(uint32_t max_frames) {
+	if (beacon == nullptr) {
+		return false;
+	}
+
+	uint32_t slot = tdma_handler->get_timeslot();
+	for (uint32_t i = 0; i < max_frames; i++) {
+		rf_transport::frame rx_frame;
+		if (!beacon->rx_sync(rx_frame, 1)) {
+			continue;
+		}
+
+		auto msg = airv2::decode(rx_frame.bytes());
+		if (!msg.has_value() || airv2::get_type(*msg) != airv2::BEACON) {
+			continue;
+		}
+
+		// Beacon edge is control's frame start, a late beacon means our
+		// clock runs early
+		get_clock_sync().update(
+			-beacon->get_arrival_error(), slot_clock::clock::now());
+
+		if (airv2::get_slot_state(*msg, slot) == airv2::GO_REQUESTED) {
+			return true;
+		}
+	}
+	return false;
 }
 
 void message_worker::send_clear() {
+	if (version == AIRV2) {
+		// Control answers with a final command once it freed the slot
+		arq.request(airv2::make(airv2::CLEAR, 0, 0, 0), airv2::COMMAND);
+		return;
+	}
+
 	tdma_handler->tx_sync(CLEAR);
 }
 
 void message_worker::send_acknowledge() {
+	if (version == AIRV2) {
+		arq.post(airv2::make(airv2::ACKNOWLEDGE, 0, 0, 0));
+		return;
+	}
+
 	tdma_handler->tx_sync(ACKNOWLEDGE);
 }
 
-std::string format_checkin() {
-	return MSG_HEADER + " " + CHECK;
+std::string format_checkin(protocol_version version) {
+	return format_header(version) + " " + CHECK;
 }
 
 std::string message_worker::format_request(uint8_t desired_pos) {
@@ -10,6 +10,10 @@
 #include <optional>
 #include <string>
 
+#include <shared/airv2.hpp>
+#include <shared/arq.hpp>
+#include <shared/clocksync.hpp>
+#include <shared/messages.hpp>
 #include <shared/tdma.hpp>
 
 class message_worker {
@@ -22,22 +26,62 @@ public:
 	/**
 	 * @brief constructor for car message worker
 	 * @param[in] tdma_handler_in
+	 * @param[in] beacon_in beacon slot on the same radio, SPEC_BEACON only
 	 */
-	message_worker(const std::shared_ptr<tdma> &tdma_handler_in);
+	message_worker(const std::shared_ptr<tdma> &tdma_handler_in,
+		const std::shared_ptr<tdma> &beacon_in = nullptr);
 
 	/**
 	 * @brief send and receive check in from control
+	 * @note feeds the reported timing offset to the slot clock tracker
+	 * @note check in is repeated a few times before falling back to AIRv1.0,
+	 * every check in tries AIRv2 again
+	 * @note with SPEC_DYNAMIC timing a data slot is requested first
 	 * @return control id
 	 */
 	std::optional<std::string> send_checkin();
 
 	/**
-	 * @brief send request callback
+	 * @brief set the position of the car
+	 * @note defaults to the timeslot, which dynamic slots do not match
+	 * @param[in] position entrance the car waits at
+	 */
+	inline void set_position(uint8_t position) {
+		current_pos = position;
+	}
+
+	/**
+	 * @brief set the turn times sent with AIRv2 requests
+	 * @note control reserves the intersection for that long
+	 * @param[in] times calibrated turn times
+	 */
+	inline void set_turn_times(const airv2::turn_times &times) {
+		turn_times = times;
+	}
+
+	/**
+	 * @brief get the slot clock tracker shared by all workers
+	 * @return clock tracker
+	 */
+	static clock_sync &get_clock_sync();
+
+	/**
+	 * @brief send request and acknowledge the command
+	 * @note AIRv2 requests are repeated every frame until answered
 	 */
 	message_worker::command send_request(uint8_t desired_pos);
 
+	/**
+	 * @brief wait in standby until the beacon announces go for our slot
+	 * @note every beacon heard also steers the slot clock
+	 * @param[in] max_frames beacons to wait for
+	 * @return true once go was announced, false without a beacon
+	 */
+	bool await_go(uint32_t max_frames);
+
 	/**
 	 * @brief send clear
+	 * @note AIRv2 clears are repeated every frame until finalized
 	 */
 	void send_clear();
 
@@ -55,7 +99,27 @@ public:
 	std::string format_request(uint8_t desired_pos);
 
 private:
+	/**
+	 * @brief receive command from control
+	 * @return command, std::nullopt if nothing valid was received
+	 */
+	std::optional<message_worker::command> receive_command();
+
+	/**
+	 * @brief send AIRv2 request and wait for the command
+	 * @param[in] desired_pos position car is requesting to go
+	 * @return command, std::nullopt if control never answered
+	 */
+	std::optional<message_worker::command> request_command(
+		uint8_t desired_pos);
+
 	std::shared_ptr<tdma> tdma_handler;
+	std::shared_ptr<tdma> beacon;
 	std::shared_ptr<std::string> car_id;
 	uint8_t current_pos;
+	std::optional<airv2::turn_times> turn_times;
+	// Protocol of the current session, AIRv2 unless control did not answer it
+	protocol_version version = AIRV2;
+	// Session assigned by control at check in
+	arq_session arq;
 };
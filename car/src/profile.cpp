@@ -112,7 +112,7 @@ void profile::save(const std::string &filename) const {
 	if (turn_profile.has_value()) {
 		file << CHECK_TURN << '\n';
 		file << CHECK_TURN_RIGHT_MS << ' ' << turn_profile->right_ms << '\n';
-		file << CHECK_TURN_RIGHT_DELAY_MS << ' ' << turn_profile->left_delay_ms
+		file << CHECK_TURN_RIGHT_DELAY_MS << ' ' << turn_profile->right_delay_ms
 			 << '\n';
 		file << CHECK_TURN_LEFT_MS << ' ' << turn_profile->left_ms << '\n';
 		file << CHECK_TURN_LEFT_DELAY_MS << ' ' << turn_profile->left_delay_ms
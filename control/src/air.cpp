@@ -4,29 +4,32 @@
  */
 #include "air.hpp"
 
-#include <atomic>
+#include <cstdio>
 #include <iostream>
 #include <thread>
 
+#include <shared/utils.hpp>
+
 #include "controller.hpp"
 
 constexpr uint8_t INTERSECTION_SIZE = 4;
 
-static void control_logic();
-
-// NOLINTBEGIN: state flags
-static std::atomic<bool> active = true;
-
-// NOLINTEND
-
 void run_air() {
-	auto control_thread = std::thread(control_logic);
-}
-
-void control_logic() {
 	controller control(INTERSECTION_SIZE, tdma::scheme::AIR_A);
 
-	while (active) {
-		control.process_requests();
+	auto control_thread = std::thread([&control]() {
+		while (control.is_active()) {
+			control.process_requests();
+		}
+	});
+
+	std::cout << "AIR running. Hit space to stop\n";
+	raw_tty();
+	while (std::getchar() != ' ') {
 	}
+	restore_tty();
+
+	// Wakes process_requests() even without events
+	control.stop();
+	control_thread.join();
 }
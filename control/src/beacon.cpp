@@ -0,0 +1,84 @@
+/**
+ * @file src/beacon.cpp
+ * @brief control beacon announcing the command of every slot
+ */
+#include "beacon.hpp"
+
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+
+#include <shared/airv2.hpp>
+#include <shared/slotclock.hpp>
+#include <shared/slotmux.hpp>
+#include <shared/tdma.hpp>
+
+beacon::beacon(
+	const std::shared_ptr<slot_mux> &mux_in, std::atomic<bool> &active_flag_in)
+	: active_flag(active_flag_in),
+	  slot_count(tdma::slot_count(mux_in->get_scheme())) {
+	if (!tdma::get_table(mux_in->get_scheme(), mux_in->get_mode())
+			 .has_beacon) {
+		throw std::invalid_argument("Timing has no beacon slot");
+	}
+
+	tdma_handler = std::make_shared<tdma>(
+		mux_in, tdma::beacon_slot(mux_in->get_scheme()));
+	thread = std::make_unique<std::thread>([this]() {
+		worker_loop();
+	});
+}
+
+beacon::~beacon() {
+	thread->join();
+}
+
+void beacon::set_state(uint32_t slot, std::optional<airv2::command> state) {
+	std::lock_guard<std::mutex> guard(lock);
+	if (slot < states.size()) {
+		states[slot] = state;
+	}
+}
+
+void beacon::grant(uint8_t nonce, uint32_t slot) {
+	std::lock_guard<std::mutex> guard(lock);
+	grants.emplace_back(nonce, slot);
+}
+
+void beacon::set_open_slots(uint16_t slots) {
+	std::lock_guard<std::mutex> guard(lock);
+	open_slots = slots;
+}
+
+void beacon::worker_loop() {
+	const auto &table = tdma_handler->get_timing_table();
+	while (active_flag) {
+		// Sample the states as late as possible, during the slot before
+		auto due = tdma_handler->next_start();
+		slot_clock::sleep_until(due - table.slot_duration);
+
+		// Frame index of the beacon about to go out, the timing reference
+		auto into_cycle = due - slot_clock::cycle_start(due);
+		auto msg = airv2::make_beacon(
+			(uint8_t)(into_cycle / table.frame_duration), (uint8_t)slot_count);
+
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			for (uint32_t slot = 0; slot < slot_count; slot++) {
+				airv2::set_slot_state(msg, slot, states[slot]);
+			}
+			airv2::set_open_slots(msg, open_slots);
+			for (size_t i = 0; i < airv2::GRANTS && !grants.empty(); i++) {
+				airv2::set_grant(
+					msg, i, grants.front().first, grants.front().second);
+				grants.pop_front();
+			}
+		}
+
+		// One frame per TDMA frame, however many cars there are
+		if (tdma_handler->tx_sync(airv2::encode(msg))) {
+			sent++;
+		}
+	}
+}
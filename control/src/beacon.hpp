@@ -0,0 +1,80 @@
+/**
+ * @file src/beacon.hpp
+ * @brief control beacon announcing the command of every slot
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+
+#include <shared/airv2.hpp>
+#include <shared/slotmux.hpp>
+#include <shared/tdma.hpp>
+
+class beacon {
+public:
+	/**
+	 * @brief constructor, starts sending in every frame
+	 * @note the multiplexer must use SPEC_BEACON timing
+	 * @param[in] mux_in radio of control
+	 * @param[in] active_flag_in sending stops once cleared
+	 */
+	beacon(const std::shared_ptr<slot_mux> &mux_in,
+		std::atomic<bool> &active_flag_in);
+
+	~beacon();
+
+	/**
+	 * @brief set the command announced for a slot
+	 * @param[in] slot timeslot
+	 * @param[in] state command, std::nullopt once the session is over
+	 */
+	void set_state(uint32_t slot, std::optional<airv2::command> state);
+
+	/**
+	 * @brief announce a slot grant in the next beacon with room
+	 * @note airv2::GRANTS grants per beacon, the rest wait in order
+	 * @param[in] nonce nonce of the car's slot request
+	 * @param[in] slot granted timeslot
+	 */
+	void grant(uint8_t nonce, uint32_t slot);
+
+	/**
+	 * @brief set the slots cars may ask for a slot in
+	 * @param[in] slots bit per timeslot
+	 */
+	void set_open_slots(uint16_t slots);
+
+	/**
+	 * @brief get the number of beacons sent
+	 * @return beacon count
+	 */
+	inline uint64_t get_sent() const {
+		return sent;
+	}
+
+private:
+	/**
+	 * @brief sends one beacon per frame until inactive
+	 */
+	void worker_loop();
+
+	// NOLINTNEXTLINE
+	std::atomic<bool> &active_flag;
+	std::shared_ptr<tdma> tdma_handler;
+	uint32_t slot_count;
+	// Guards states, grants & open slots
+	std::mutex lock;
+	std::array<std::optional<airv2::command>, airv2::BEACON_SLOTS> states;
+	std::deque<std::pair<uint8_t, uint32_t>> grants;
+	uint16_t open_slots = 0;
+	std::atomic<uint64_t> sent = 0;
+	std::unique_ptr<std::thread> thread;
+};
@@ -12,7 +12,9 @@
 #include <driver/device.hpp>
 #include <driver/drf7020d20.hpp>
 #include <driver/pinmap.hpp>
+#include <shared/framecheck.hpp>
 #include <shared/menu.hpp>
+#include <shared/slotclock.hpp>
 #include <shared/tdma.hpp>
 #include <shared/utils.hpp>
 
@@ -50,12 +52,17 @@ void assist_calibrate() {
 	std::cout << "Starting assiting...\n";
 	std::cout << "Hit any key to exit\n";
 	while (!finish) {
-		auto request = rf_module->receive(std::chrono::milliseconds(50));
-		if (request.empty()) {
+		rf_transport::frame request;
+		if (!rf_module->receive(request, std::chrono::milliseconds(50))) {
 			continue;
 		}
 
-		rf_module->transmit(std::to_string(generate_ms() - 13));
+		// When the car started sending, on the same cycle as its slots
+		auto sent = request.arrival - rf_module->get_frame_airtime();
+		auto sent_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+			slot_clock::cycle_offset(sent));
+		// The car checks frames like any TDMA slot
+		rf_module->transmit(seal_frame(std::to_string(sent_ms.count())));
 		std::cout << "Hit\n";
 	}
 
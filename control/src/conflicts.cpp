@@ -0,0 +1,117 @@
+/**
+ * @file src/conflicts.cpp
+ * @brief zones of the intersection each movement passes through
+ */
+#include "conflicts.hpp"
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <utility>
+
+#include "conflicttables.hpp"
+
+// Indexed by intersection size - 1
+static constexpr conflict_matrix::table
+	CONFLICT_TABLES[conflict_matrix::MAX_POSITIONS] = {
+		CONFLICT_TABLE<1>,
+		CONFLICT_TABLE<2>,
+		CONFLICT_TABLE<3>,
+		CONFLICT_TABLE<4>,
+		CONFLICT_TABLE<5>,
+		CONFLICT_TABLE<6>,
+		CONFLICT_TABLE<7>,
+		CONFLICT_TABLE<8>,
+		CONFLICT_TABLE<9>,
+		CONFLICT_TABLE<10>,
+		CONFLICT_TABLE<11>,
+		CONFLICT_TABLE<12>,
+		CONFLICT_TABLE<13>,
+		CONFLICT_TABLE<14>,
+		CONFLICT_TABLE<15>,
+		CONFLICT_TABLE<16>,
+};
+
+/**
+ * @brief check the geometry of every table
+ * @return true if all sizes are consistent
+ */
+template<uint32_t... SIZES>
+static constexpr bool all_consistent(
+	std::integer_sequence<uint32_t, SIZES...> /*sizes*/) {
+	return (movement_zones<SIZES + 1>::consistent() && ...);
+}
+
+static_assert(all_consistent(
+	std::make_integer_sequence<uint32_t, conflict_matrix::MAX_POSITIONS>()));
+
+conflict_matrix::conflict_matrix(uint32_t positions_in)
+	: positions(positions_in),
+	  matrix(nullptr) {
+	if (positions == 0 || positions > MAX_POSITIONS) {
+		throw std::invalid_argument("Unsupported intersection size");
+	}
+
+	matrix = &CONFLICT_TABLES[positions - 1];
+}
+
+uint32_t conflict_matrix::largest_compatible(
+	std::span<const zone_mask> movements, zone_mask occupied) {
+	std::array<uint32_t, MAX_MOVEMENTS> conflicting = {};
+	uint32_t allowed = 0;
+	for (size_t i = 0; i < movements.size(); i++) {
+		if ((movements[i] & occupied) == 0) {
+			allowed |= 1U << i;
+		}
+		for (size_t j = 0; j < movements.size(); j++) {
+			if (i != j && (movements[i] & movements[j]) != 0) {
+				conflicting[i] |= 1U << j;
+			}
+		}
+	}
+	return largest_compatible(
+		std::span(conflicting.data(), movements.size()), allowed);
+}
+
+/**
+ * @brief extend a set of movements with the remaining ones
+ * @note taking a movement is tried first, so the first set of a size found
+ * prefers the earlier movements
+ * @param[in] conflicting conflict masks of the movements
+ * @param[in] remaining movements that still fit the chosen ones
+ * @param[in] chosen movements taken so far
+ * @param[in,out] best largest set found so far
+ */
+static void search_compatible(std::span<const uint32_t> conflicting,
+	uint32_t remaining,
+	uint32_t chosen,
+	uint32_t &best) {
+	if (std::popcount(chosen) + std::popcount(remaining) <=
+		std::popcount(best)) {
+		return;
+	}
+	if (remaining == 0) {
+		best = chosen;
+		return;
+	}
+
+	uint32_t next = std::countr_zero(remaining);
+	uint32_t bit = 1U << next;
+	remaining &= ~bit;
+	search_compatible(
+		conflicting, remaining & ~conflicting[next], chosen | bit, best);
+	search_compatible(conflicting, remaining, chosen, best);
+}
+
+uint32_t conflict_matrix::largest_compatible(
+	std::span<const uint32_t> conflicting, uint32_t allowed) {
+	if (conflicting.size() < MAX_MOVEMENTS) {
+		allowed &= (1U << conflicting.size()) - 1;
+	}
+
+	uint32_t best = 0;
+	search_compatible(conflicting, allowed, 0, best);
+	return best;
+}
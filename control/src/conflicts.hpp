@@ -0,0 +1,100 @@
+/**
+ * @file src/conflicts.hpp
+ * @brief zones of the intersection each movement passes through
+ */
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <span>
+
+class conflict_matrix {
+public:
+	// Positions are 4 bits in AIRv2 requests
+	static constexpr uint32_t MAX_POSITIONS = 16;
+	// Movements largest_compatible() decides on at once
+	static constexpr uint32_t MAX_MOVEMENTS = 32;
+
+	// Zone i joins position i to the next one, one bit each
+	using zone_mask = uint16_t;
+	// Indexed by entry, then exit
+	using table = std::array<std::array<zone_mask, MAX_POSITIONS>,
+		MAX_POSITIONS>;
+
+	/**
+	 * @brief constructor, picks the compile-time table of the size
+	 * @note movements go around the intersection in position order, a car
+	 * leaving where it came in goes all the way around
+	 * @param[in] positions_in number of entrances, at most MAX_POSITIONS
+	 */
+	explicit conflict_matrix(uint32_t positions_in);
+
+	/**
+	 * @brief get the number of entrances
+	 * @return position count
+	 */
+	inline uint32_t get_positions() const {
+		return positions;
+	}
+
+	/**
+	 * @brief check that a movement exists in this intersection
+	 * @param[in] entry current position of the car
+	 * @param[in] exit requested position
+	 * @return true if both positions exist
+	 */
+	inline bool valid(uint8_t entry, uint8_t exit) const {
+		return entry < positions && exit < positions;
+	}
+
+	/**
+	 * @brief get the zones a movement passes through
+	 * @param[in] entry current position of the car, must be valid
+	 * @param[in] exit requested position, must be valid
+	 * @return zone mask
+	 */
+	inline zone_mask zones(uint8_t entry, uint8_t exit) const {
+		return (*matrix)[entry][exit];
+	}
+
+	/**
+	 * @brief check a movement against the zones in use
+	 * @param[in] occupied zones of the cars already moving
+	 * @param[in] entry current position of the car, must be valid
+	 * @param[in] exit requested position, must be valid
+	 * @return true if the movement crosses none of them
+	 */
+	inline bool compatible(
+		zone_mask occupied, uint8_t entry, uint8_t exit) const {
+		return (occupied & (*matrix)[entry][exit]) == 0;
+	}
+
+	/**
+	 * @brief pick the most movements that cross neither each other nor
+	 * the zones in use
+	 * @note exact search over bitmasks without allocating, fine for the up
+	 * to 16 cars of a frame
+	 * @param[in] movements zone masks of the waiting cars, at most
+	 * MAX_MOVEMENTS
+	 * @param[in] occupied zones of the cars already moving
+	 * @return bit i set if movement i goes, ties go to earlier movements
+	 */
+	static uint32_t largest_compatible(
+		std::span<const zone_mask> movements, zone_mask occupied);
+
+	/**
+	 * @brief pick the most movements that do not conflict pairwise
+	 * @note same search as above for conflicts other than shared zones
+	 * @param[in] conflicting bit j of entry i set if movements i & j
+	 * conflict, at most MAX_MOVEMENTS
+	 * @param[in] allowed bit i set if movement i may go at all
+	 * @return bit i set if movement i goes, ties go to earlier movements
+	 */
+	static uint32_t largest_compatible(
+		std::span<const uint32_t> conflicting, uint32_t allowed);
+
+private:
+	uint32_t positions;
+	// See conflicttables.hpp
+	const table *matrix;
+};
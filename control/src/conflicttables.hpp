@@ -0,0 +1,98 @@
+/**
+ * @file src/conflicttables.hpp
+ * @brief compile-time zone tables for every intersection size
+ */
+#pragma once
+
+#include <bit>
+#include <cstdint>
+
+#include "conflicts.hpp"
+
+/**
+ * @brief zones of the movements in an intersection
+ * @tparam POSITIONS number of entrances
+ */
+template<uint32_t POSITIONS>
+struct movement_zones {
+	static_assert(POSITIONS > 0 &&
+				  POSITIONS <= conflict_matrix::MAX_POSITIONS);
+
+	static constexpr conflict_matrix::zone_mask ALL =
+		(conflict_matrix::zone_mask)((1U << POSITIONS) - 1);
+
+	/**
+	 * @brief zones from the entry around to the exit
+	 * @param[in] entry current position of the car
+	 * @param[in] exit requested position
+	 * @return zone mask, all zones if the car leaves where it came in
+	 */
+	static constexpr conflict_matrix::zone_mask zones(
+		uint32_t entry, uint32_t exit) {
+		conflict_matrix::zone_mask mask = 0;
+		uint32_t zone = entry;
+		do {
+			mask |= (conflict_matrix::zone_mask)(1U << zone);
+			zone = (zone + 1) % POSITIONS;
+		} while (zone != exit);
+		return mask;
+	}
+
+	/**
+	 * @brief table of every movement, unused positions stay empty
+	 * @return table indexed by entry, then exit
+	 */
+	static constexpr conflict_matrix::table make() {
+		conflict_matrix::table table = {};
+		for (uint32_t entry = 0; entry < POSITIONS; entry++) {
+			for (uint32_t exit = 0; exit < POSITIONS; exit++) {
+				table[entry][exit] = zones(entry, exit);
+			}
+		}
+		return table;
+	}
+
+	/**
+	 * @brief check the table geometry
+	 * @return true if every movement passes the zones up to its exit and
+	 * the way back takes exactly the other zones
+	 */
+	static constexpr bool consistent() {
+		auto table = make();
+		for (uint32_t entry = 0; entry < POSITIONS; entry++) {
+			for (uint32_t exit = 0; exit < POSITIONS; exit++) {
+				auto there = table[entry][exit];
+				auto back = table[exit][entry];
+				uint32_t length = (exit + POSITIONS - entry) % POSITIONS;
+				if (entry == exit) {
+					if (there != ALL) {
+						return false;
+					}
+				} else if ((there & back) != 0 || (there | back) != ALL ||
+						   (uint32_t)std::popcount(there) != length) {
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+};
+
+template<uint32_t POSITIONS>
+inline constexpr conflict_matrix::table CONFLICT_TABLE =
+	movement_zones<POSITIONS>::make();
+
+// One zone to the next position, the rest of the way around back
+static_assert(CONFLICT_TABLE<4>[0][1] == 0b0001);
+static_assert(CONFLICT_TABLE<4>[1][0] == 0b1110);
+// Wraps past the last position
+static_assert(CONFLICT_TABLE<4>[3][1] == 0b1001);
+static_assert(CONFLICT_TABLE<4>[2][2] == 0b1111);
+static_assert(CONFLICT_TABLE<16>[15][15] == 0xFFFF);
+// Halves from opposite sides fit together, overlapping halves do not
+static_assert((CONFLICT_TABLE<4>[0][1] & CONFLICT_TABLE<4>[2][3]) == 0);
+static_assert((CONFLICT_TABLE<4>[0][2] & CONFLICT_TABLE<4>[2][0]) == 0 &&
+			  (CONFLICT_TABLE<4>[0][2] & CONFLICT_TABLE<4>[1][3]) != 0);
+static_assert(movement_zones<1>::consistent());
+static_assert(movement_zones<4>::consistent());
+static_assert(movement_zones<16>::consistent());
@@ -4,84 +4,491 @@
  */
 #include "controller.hpp"
 
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <mutex>
+#include <span>
+
 #include <driver/device.hpp>
+#include <driver/drf7020d20.hpp>
 #include <driver/pinmap.hpp>
+#include <shared/airv2.hpp>
+#include <shared/framecheck.hpp>
+#include <shared/slotclock.hpp>
+
+/**
+ * @brief Open the intersection radio.
+ * @note Fielded AIRv1.0 cars send frames without a trailer.
+ *
+ * @return Radio transport.
+ */
+static std::shared_ptr<rf_transport> open_radio();
 
 controller::controller(uint8_t intersect_size, tdma::scheme div)
-	: rf_module(std::make_shared<drf7020d20>(
-		  gpio_pins, RASPI_12, RASPI_11, RASPI_7, 0)),
-	  active(true) {
-	blocked_intersects.reserve(intersect_size);
-	workers.reserve(intersect_size);
-	for (uint32_t i = 0; i < intersect_size; i++) {
-		auto tdma_ptr = std::make_shared<tdma>(rf_module, i, div);
-		message_worker worker(tdma_ptr, active);
-		auto executor = [&](uint8_t curr_pos, uint8_t requested_pos,
-							std::string &car_id, message_worker &worker) {
-			receive_request_callback(curr_pos, requested_pos, car_id, worker);
-		};
-		worker.await_request(executor);
-		workers.push_back(
-			std::move(worker)); // check if push back causes problems
-		blocked_intersects.push_back(false);
+	: controller(open_radio(), intersect_size, div) {}
+
+controller::controller(const std::shared_ptr<rf_transport> &rf_module_in,
+	uint8_t intersect_size,
+	tdma::scheme div,
+	tdma::timing_mode mode,
+	std::optional<std::chrono::nanoseconds> start_slack)
+	: rf_module(rf_module_in),
+	  mux(std::make_shared<slot_mux>(rf_module, div, mode)),
+	  active(true),
+	  conflicts(intersect_size) {
+	const auto &table = tdma::get_table(div, mode);
+	if (table.has_beacon) {
+		downlink = std::make_unique<beacon>(mux, active);
+	}
+	if (table.has_contention) {
+		allocator = std::make_unique<slot_allocator>(mux, *downlink, active);
+	}
+	// A beacon opens every frame, cars give up on their go after
+	// airv2::STANDBY_BEACONS of them
+	standby_timeout = table.frame_duration * airv2::STANDBY_BEACONS;
+	timing = &table;
+	if (start_slack.has_value()) {
+		reservations =
+			std::make_unique<reservation_manager>(conflicts, *start_slack);
+	}
+
+	// Granted slots do not follow the position, listen in all of them
+	uint32_t worker_count =
+		table.has_contention ? table.slot_count : intersect_size;
+	workers.reserve(worker_count);
+	for (uint32_t i = 0; i < worker_count; i++) {
+		auto tdma_ptr = std::make_shared<tdma>(mux, i);
+		workers.emplace_back(tdma_ptr, active);
+	}
+
+	// Worker threads keep a pointer to their worker, start them once in place
+	for (uint32_t i = 0; i < worker_count; i++) {
+		await_request(i);
 	}
 }
 
+controller::~controller() {
+	// Worker threads post events, join them while the queue is still there
+	stop();
+	workers.clear();
+}
+
 void controller::receive_request_callback(uint8_t current_pos,
 	uint8_t requested_pos,
-	std::string &car_id,
+	uint8_t session,
 	message_worker &worker) {
-	car car = {
-		.car_id = std::move(car_id),
-		.state = CHECKIN,
+	push_event({
+		.type = REQUEST,
+		.slot = worker.get_timeslot(),
+		.session = session,
 		.current_pos = current_pos,
 		.request_pos = requested_pos,
-	};
+		.times = worker.get_turn_times(),
+		.received = true,
+	});
+}
 
-	lock.lock();
-	cars.insert(cars.begin() + worker.get_timeslot(), car);
-	lock.unlock();
+void controller::acknowledge_callback(bool received, message_worker &worker) {
+	push_event({
+		.type = ACKNOWLEDGE,
+		.slot = worker.get_timeslot(),
+		.session = worker.get_session(),
+		.current_pos = 0,
+		.request_pos = 0,
+		.times = std::nullopt,
+		.received = received,
+	});
+}
+
+void controller::clear_callback(bool cleared, message_worker &worker) {
+	push_event({
+		.type = CLEAR,
+		.slot = worker.get_timeslot(),
+		.session = worker.get_session(),
+		.current_pos = 0,
+		.request_pos = 0,
+		.times = std::nullopt,
+		.received = cleared,
+	});
+}
+
+void controller::push_event(const event &next) {
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		events.push_back(next);
+	}
+	cond.notify_one();
 }
 
 void controller::process_requests() {
-	for (auto &curr : cars) {
-		uint8_t curr_pos = curr.current_pos;
-		uint8_t request_pos = curr.request_pos;
-		if (curr.state == CHECKIN) {
-			if (blocked_intersects[request_pos]) {
-				workers[curr_pos].send_standby();
-				curr.state = STANDBY;
+	if (reservations != nullptr &&
+		reservations->expire(slot_clock::clock::now())) {
+		zones_freed = true;
+	}
+	auto deadline = next_deadline();
+
+	std::deque<event> pending;
+	{
+		std::unique_lock<std::mutex> guard(lock);
+		auto ready = [this]() {
+			return !events.empty() || !active;
+		};
+		if (deadline.has_value()) {
+			cond.wait_until(guard, *deadline, ready);
+		} else {
+			cond.wait(guard, ready);
+		}
+		pending.swap(events);
+	}
+	if (!active) {
+		return;
+	}
+
+	for (const auto &next : pending) {
+		handle_event(next);
+	}
+	if (admission_due()) {
+		admit();
+	}
+}
+
+void controller::stop() {
+	{
+		// A waiter between its check and its sleep would miss the notify
+		std::lock_guard<std::mutex> guard(lock);
+		active = false;
+	}
+	cond.notify_all();
+}
+
+bool controller::is_active() const {
+	return active;
+}
+
+void controller::handle_event(const event &next) {
+	if (next.slot >= workers.size()) {
+		return;
+	}
+
+	car &curr = cars[next.slot];
+	switch (next.type) {
+	case REQUEST:
+		curr = {
+			.session = next.session,
+			.state = CHECKIN,
+			.current_pos = next.current_pos,
+			.request_pos = next.request_pos,
+			.times = next.times,
+			.acknowledged = false,
+			.since = slot_clock::clock::now(),
+		};
+		if (allocator != nullptr) {
+			allocator->checked_in(next.slot);
+		}
+		break;
+	case ACKNOWLEDGE:
+		if (curr.session != next.session) {
+			break;
+		}
+		// A lost acknowledge still leaves the car waiting for its clear.
+		// Without a beacon no go reaches a waiting car, it clears at once.
+		curr.acknowledged = true;
+		if (curr.state == MOVING ||
+			(curr.state == STANDBY && downlink == nullptr)) {
+			workers[next.slot].await_clear(
+				[this](bool cleared, message_worker &worker) {
+					clear_callback(cleared, worker);
+				});
+		}
+		break;
+	case CLEAR:
+		if (curr.session != next.session) {
+			break;
+		}
+		// Without a clear the car is gone either way, the worker already
+		// gave up on it. Waiting cars hold no zones.
+		if (curr.state == MOVING) {
+			if (reservations != nullptr) {
+				reservations->release(next.slot);
 			} else {
-				workers[curr_pos].send_go_requested();
-				move_car(curr);
+				occupied &=
+					~conflicts.zones(curr.current_pos, curr.request_pos);
 			}
+			zones_freed = true;
+		}
+		end_session(next.slot);
+		break;
+	}
+}
+
+void controller::admit() {
+	zones_freed = false;
+
+	// Fixed size, admission runs every frame
+	std::array<uint32_t, slot_mux::MAX_SLOTS> slots = {};
+	uint32_t count = 0;
+	for (uint32_t slot = 0; slot < workers.size(); slot++) {
+		car &curr = cars[slot];
+		if (curr.session == 0 || curr.state == MOVING) {
+			continue;
+		}
+		// Only the beacon brings a waiting car its go, otherwise it is
+		// clearing already
+		if (curr.state == STANDBY && downlink == nullptr) {
+			continue;
+		}
+
+		if (!conflicts.valid(curr.current_pos, curr.request_pos)) {
+			workers[slot].send_unsupported();
+			end_session(slot);
+			continue;
+		}
+		slots[count++] = slot;
+	}
+	auto candidates = std::span(slots.data(), count);
+
+	// Waiting cars first, so they win ties. The slot breaks the remaining
+	// ties, std::stable_sort would want a heap buffer.
+	std::sort(candidates.begin(), candidates.end(),
+		[this](uint32_t lhs, uint32_t rhs) {
+			const car &left = cars[lhs];
+			const car &right = cars[rhs];
+			if ((left.state == STANDBY) != (right.state == STANDBY)) {
+				return left.state == STANDBY;
+			}
+			if (left.since != right.since) {
+				return left.since < right.since;
+			}
+			return lhs < rhs;
+		});
+
+	uint32_t chosen = 0;
+	std::array<reservation_manager::plan, slot_mux::MAX_SLOTS> plans;
+	if (reservations != nullptr) {
+		std::array<uint32_t, slot_mux::MAX_SLOTS> conflicting = {};
+		uint32_t allowed = plan_tiles(candidates, plans, conflicting);
+		chosen = conflict_matrix::largest_compatible(
+			std::span(conflicting.data(), count), allowed);
+	} else {
+		std::array<conflict_matrix::zone_mask, slot_mux::MAX_SLOTS> movements =
+			{};
+		for (uint32_t i = 0; i < count; i++) {
+			movements[i] = conflicts.zones(
+				cars[slots[i]].current_pos, cars[slots[i]].request_pos);
 		}
+		chosen = conflict_matrix::largest_compatible(
+			std::span(movements.data(), count), occupied);
+	}
+
+	for (uint32_t i = 0; i < candidates.size(); i++) {
+		uint32_t slot = candidates[i];
+		car &curr = cars[slot];
+		bool go = (chosen & (1U << i)) != 0;
+
+		if (go && reservations != nullptr) {
+			reservations->reserve(slot, plans[i]);
+		}
+
+		// Waiting cars hear the go in the next beacon
 		if (curr.state == STANDBY) {
-			if (!blocked_intersects[request_pos]) {
+			if (go) {
+				announce(curr, airv2::GO_REQUESTED);
 				move_car(curr);
 			}
+			continue;
+		}
+
+		if (go) {
+			workers[slot].send_go_requested();
+			announce(curr, airv2::GO_REQUESTED);
+			move_car(curr);
+		} else {
+			workers[slot].send_standby();
+			announce(curr, airv2::STANDBY);
+			curr.state = STANDBY;
+			curr.since = slot_clock::clock::now();
+		}
+		workers[slot].check_acknowledge(
+			[this](bool received, message_worker &worker) {
+				acknowledge_callback(received, worker);
+			});
+	}
+}
+
+uint32_t controller::plan_tiles(std::span<const uint32_t> candidates,
+	std::span<reservation_manager::plan> plans,
+	std::span<uint32_t> conflicting) const {
+	uint32_t allowed = 0;
+
+	// Every car of the pass would start now
+	auto now = slot_clock::clock::now();
+	for (size_t i = 0; i < candidates.size(); i++) {
+		const car &curr = cars[candidates[i]];
+		plans[i] = reservations->plan_movement(
+			curr.current_pos, curr.request_pos, curr.times, now);
+	}
+	for (size_t i = 0; i < candidates.size(); i++) {
+		conflicting[i] = 0;
+		if (reservations->is_free(plans[i])) {
+			allowed |= 1U << i;
+		}
+		for (size_t j = 0; j < candidates.size(); j++) {
+			if (i != j && reservation_manager::overlap(plans[i], plans[j])) {
+				conflicting[i] |= 1U << j;
+			}
+		}
+	}
+	return allowed;
+}
+
+bool controller::admission_due() const {
+	if (zones_freed) {
+		return true;
+	}
+
+	auto now = slot_clock::clock::now();
+	for (uint32_t slot = 0; slot < workers.size(); slot++) {
+		const car &curr = cars[slot];
+		if (curr.session != 0 && curr.state == CHECKIN &&
+			admission_end(slot, curr.since) <= now) {
+			return true;
+		}
+	}
+	return false;
+}
+
+std::optional<slot_clock::time_point> controller::expire_standby() {
+	// Without a beacon waiting cars clear right away, see handle_event()
+	if (downlink == nullptr) {
+		return std::nullopt;
+	}
+
+	auto now = slot_clock::clock::now();
+	std::optional<slot_clock::time_point> next;
+	for (uint32_t slot = 0; slot < workers.size(); slot++) {
+		const car &curr = cars[slot];
+		if (curr.session == 0 || curr.state != STANDBY) {
+			continue;
+		}
+
+		auto expiry = curr.since + standby_timeout;
+		if (expiry <= now) {
+			// The car sends its clear after giving up, nobody listens
+			end_session(slot);
+		} else if (!next.has_value() || expiry < *next) {
+			next = expiry;
 		}
 	}
+	return next;
+}
+
+slot_clock::time_point controller::admission_end(
+	uint32_t slot, slot_clock::time_point since) const {
+	// Deciding later would miss the slot the reply goes out in
+	auto cycle = slot_clock::cycle_start(since);
+	return cycle + timing->next_start(slot, since - cycle) -
+		   timing->slot_duration;
+}
+
+std::optional<slot_clock::time_point> controller::next_deadline() {
+	auto next = expire_standby();
+
+	// Waiting cars may fit once a tile is over
+	bool waiting = std::any_of(cars.begin(), cars.end(), [](const car &curr) {
+		return curr.session != 0 && curr.state == STANDBY;
+	});
+	if (reservations != nullptr && waiting) {
+		auto tile_end = reservations->next_end();
+		if (tile_end.has_value() && (!next.has_value() || *tile_end < *next)) {
+			next = tile_end;
+		}
+	}
+
+	for (uint32_t slot = 0; slot < workers.size(); slot++) {
+		const car &curr = cars[slot];
+		if (curr.session == 0 || curr.state != CHECKIN) {
+			continue;
+		}
+
+		auto window_end = admission_end(slot, curr.since);
+		if (!next.has_value() || window_end < *next) {
+			next = window_end;
+		}
+	}
+	return next;
 }
 
 void controller::move_car(car &car) {
 	car.state = MOVING;
-	for (uint8_t i = car.current_pos + 1; i <= car.request_pos; i++) {
-		blocked_intersects[i] = true;
+	car.since = slot_clock::clock::now();
+	admitted++;
+	if (reservations == nullptr) {
+		occupied |= conflicts.zones(car.current_pos, car.request_pos);
+	}
+
+	// Otherwise the acknowledge starts waiting for the clear
+	if (car.acknowledged) {
+		workers[airv2::session_slot(car.session)].await_clear(
+			[this](bool cleared, message_worker &worker) {
+				clear_callback(cleared, worker);
+			});
 	}
-	auto executor = [&](bool cleared, message_worker &worker) {
-		clear_callback(cleared, worker);
-	};
-	workers[car.current_pos].await_clear(executor);
 }
 
-void controller::clear_callback(bool cleared, message_worker &message_worker) {
-	car curr_car = cars[message_worker.get_timeslot()];
-	if (cleared) {
-		for (uint8_t i = curr_car.current_pos + 1; i <= curr_car.request_pos;
-			 i++) {
-			blocked_intersects[i] = false;
-		}
-		cars.erase(cars.begin() + message_worker.get_timeslot());
+void controller::end_session(uint32_t slot) {
+	announce(cars[slot], std::nullopt);
+	cars[slot].session = 0;
+	if (allocator != nullptr) {
+		allocator->release(slot);
 	}
+	await_request(slot);
+}
+
+void controller::await_request(uint32_t slot) {
+	workers[slot].await_request(
+		[this](uint8_t curr_pos, uint8_t requested_pos, uint8_t session,
+			message_worker &worker) {
+			receive_request_callback(curr_pos, requested_pos, session, worker);
+		});
+}
+
+void controller::announce(
+	const car &car, std::optional<airv2::command> state) {
+	if (downlink != nullptr) {
+		downlink->set_state(airv2::session_slot(car.session), state);
+	}
+}
+
+void controller::print_stats(FILE *out) const {
+	uint64_t repeats = 0;
+	for (const auto &worker : workers) {
+		repeats += worker.get_arq().get_repeats();
+	}
+
+	std::fprintf(out, "Cars let go: %llu\n", (unsigned long long)admitted);
+	if (reservations != nullptr) {
+		std::fprintf(out, "Cars let go into zones reserved by others: %llu\n",
+			(unsigned long long)reservations->get_shared());
+	}
+	std::fprintf(out, "Frames dropped by slot routing: %llu\n",
+		(unsigned long long)mux->get_dropped());
+	if (downlink != nullptr) {
+		std::fprintf(out, "Beacons sent: %llu\n",
+			(unsigned long long)downlink->get_sent());
+	}
+	if (allocator != nullptr) {
+		std::fprintf(out, "Slots granted: %llu, refused: %llu\n",
+			(unsigned long long)allocator->get_granted(),
+			(unsigned long long)allocator->get_refused());
+	}
+	std::fprintf(out, "AIRv2 repeats answered: %llu\n",
+		(unsigned long long)repeats);
+}
+
+std::shared_ptr<rf_transport> open_radio() {
+	auto rf_dev = std::make_shared<drf7020d20>(
+		gpio_pins, RASPI_12, RASPI_11, RASPI_7, 0);
+	set_link_coding(rf_dev, FRAME_CRC_LEGACY);
+	return rf_dev;
 }
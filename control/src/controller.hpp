@@ -4,18 +4,32 @@
  */
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
 #include <cstdlib>
 #include <deque>
 #include <map>
 #include <memory>
 #include <mutex>
+#include <optional>
+#include <span>
 #include <string>
 #include <vector>
 
-#include <driver/drf7020d20.hpp>
+#include <driver/transport.hpp>
+#include <shared/airv2.hpp>
+#include <shared/slotclock.hpp>
+#include <shared/slotmux.hpp>
 #include <shared/tdma.hpp>
 
+#include "beacon.hpp"
+#include "conflicts.hpp"
 #include "messageworker.hpp"
+#include "reservations.hpp"
+#include "slotallocator.hpp"
 
 class controller {
 public:
@@ -26,10 +40,17 @@ public:
 	};
 
 	struct car {
-		std::string car_id;
+		// Session token, 0 for a free slot
+		uint8_t session;
 		car_state state;
 		uint8_t current_pos;
 		uint8_t request_pos;
+		// Sent with AIRv2 requests
+		std::optional<airv2::turn_times> times;
+		// Command was acknowledged, the clear comes next
+		bool acknowledged;
+		// Last state change
+		slot_clock::time_point since;
 	};
 
 	/**
@@ -39,42 +60,225 @@ public:
 	 */
 	controller(uint8_t intersect_size, tdma::scheme div);
 
+	/**
+	 * @brief constructor for controller on a given radio transport
+	 * @note SPEC_BEACON timing also announces every slot's command in the
+	 * beacon, SPEC_DYNAMIC timing also hands out slots on request
+	 * @param[in] rf_module_in
+	 * @param[in] intersect_size
+	 * @param[in] div
+	 * @param[in] mode
+	 * @param[in] start_slack reserve zones for the car's turn times,
+	 * allowing it to start this late after its go, instead of locking its
+	 * path until the clear
+	 */
+	controller(const std::shared_ptr<rf_transport> &rf_module_in,
+		uint8_t intersect_size,
+		tdma::scheme div,
+		tdma::timing_mode mode = tdma::LEGACY,
+		std::optional<std::chrono::nanoseconds> start_slack = std::nullopt);
+
+	/**
+	 * @brief stops and joins the workers while their events can still go
+	 * somewhere
+	 */
+	~controller();
+
 	/**
 	 * @brief callback for car request receival
+	 * @note only queues the request, runs on the worker's thread
 	 * @param[in] current_pos
 	 * @param[in] requested_pos
-	 * @param[in] car_id
+	 * @param[in] session
 	 * @param[in] worker
 	 */
 	void receive_request_callback(uint8_t current_pos,
 		uint8_t requested_pos,
-		std::string &car_id,
+		uint8_t session,
 		message_worker &worker);
 
 	/**
-	 * @brief process car requests
+	 * @brief waits for car events or a timer, then decides on them
+	 * @note blocks without events, all car state changes happen here.
+	 * Requests wait for the other slots of their frame. Returns without
+	 * deciding once stopped.
 	 */
 	void process_requests();
 
+	/**
+	 * @brief stop the workers and wake process_requests()
+	 * @note safe from any thread
+	 */
+	void stop();
+
+	/**
+	 * @brief check if the controller was not stopped
+	 * @return true while running
+	 */
+	bool is_active() const;
+
+	/**
+	 * @brief get the number of cars let go
+	 * @return admission count
+	 */
+	inline uint64_t get_admitted() const {
+		return admitted;
+	}
+
+	/**
+	 * @brief print radio, beacon, slot and ARQ statistics
+	 * @note only once process_requests() stopped
+	 * @param[in] out output stream, e.g. stdout
+	 */
+	void print_stats(FILE *out) const;
+
+	/**
+	 * @brief callback for acknowledge receivals
+	 * @note only queues the acknowledge, runs on the worker's thread
+	 * @param[in] received
+	 * @param[in] worker
+	 */
+	void acknowledge_callback(bool received, message_worker &worker);
+
 	/**
 	 * @brief callback for clear receivals
+	 * @note only queues the clear, runs on the worker's thread
 	 * @param[in] cleared
 	 * @param[in] worker
 	 */
 	void clear_callback(bool cleared, message_worker &worker);
 
 	/**
-	 * @brief places car in moving state and blocks entrances
+	 * @brief places car in moving state and occupies its zones
+	 * @note with reservations the caller reserves the tiles
 	 * @param[in] car
 	 */
 	void move_car(car &car);
 
+	/**
+	 * @brief announces a command in the beacon, if there is one
+	 * @param[in] car
+	 * @param[in] state command, std::nullopt once the car left
+	 */
+	void announce(const car &car, std::optional<airv2::command> state);
+
 private:
-	std::shared_ptr<drf7020d20> rf_module;
+	enum event_type {
+		REQUEST,
+		ACKNOWLEDGE,
+		CLEAR,
+	};
+
+	struct event {
+		event_type type;
+		uint32_t slot;
+		uint8_t session;
+		uint8_t current_pos;
+		uint8_t request_pos;
+		std::optional<airv2::turn_times> times;
+		// Acknowledge or clear arrived
+		bool received;
+	};
+
+	/**
+	 * @brief queue an event for process_requests()
+	 * @param[in] next
+	 */
+	void push_event(const event &next);
+
+	/**
+	 * @brief apply an event to the car in its slot
+	 * @param[in] next
+	 */
+	void handle_event(const event &next);
+
+	/**
+	 * @brief let the largest compatible set of cars go, the other checked
+	 * in cars stand by
+	 * @note waiting cars win ties, oldest first. They only take part with a
+	 * beacon to hear the go in.
+	 */
+	void admit();
+
+	/**
+	 * @brief lay out the tiles of cars starting now and find the overlaps
+	 * @param[in] candidates timeslots of the cars
+	 * @param[out] plans tiles of each car, at least as many as candidates
+	 * @param[out] conflicting bit j of entry i set if cars i & j overlap,
+	 * at least as many as candidates
+	 * @return bit i set if car i fits the reserved tiles
+	 */
+	uint32_t plan_tiles(std::span<const uint32_t> candidates,
+		std::span<reservation_manager::plan> plans,
+		std::span<uint32_t> conflicting) const;
+
+	/**
+	 * @brief check if a frame of requests is in or zones freed
+	 * @return true if admit() should run
+	 */
+	bool admission_due() const;
+
+	/**
+	 * @brief get the end of the admission window of a request
+	 * @note the slot before the car's slot comes around again, the
+	 * requests of every other slot are in by then
+	 * @param[in] slot
+	 * @param[in] since arrival of the request
+	 * @return window end
+	 */
+	slot_clock::time_point admission_end(
+		uint32_t slot, slot_clock::time_point since) const;
+
+	/**
+	 * @brief drop waiting cars that gave up on their go
+	 * @return time the next waiting car gives up, std::nullopt if none wait
+	 */
+	std::optional<slot_clock::time_point> expire_standby();
+
+	/**
+	 * @brief get the time process_requests() has to wake up at
+	 * @return standby expiry or end of the admission window, std::nullopt
+	 * if neither
+	 */
+	std::optional<slot_clock::time_point> next_deadline();
+
+	/**
+	 * @brief end the session in a slot and listen for the next car
+	 * @param[in] slot
+	 */
+	void end_session(uint32_t slot);
+
+	/**
+	 * @brief listen for the next car's request in a slot
+	 * @param[in] slot
+	 */
+	void await_request(uint32_t slot);
+
+	std::shared_ptr<rf_transport> rf_module;
+	std::shared_ptr<slot_mux> mux;
 	std::atomic<bool> active;
+	// Only with SPEC_BEACON timing
+	std::unique_ptr<beacon> downlink;
+	// Only with SPEC_DYNAMIC timing, stops before the beacon it grants in
+	std::unique_ptr<slot_allocator> allocator;
 	std::vector<tdma> tdmas;
+	// Indexed by slot, which is also the position without SPEC_DYNAMIC
 	std::vector<message_worker> workers;
-	std::vector<bool> blocked_intersects;
-	std::deque<car> cars;
+	conflict_matrix conflicts;
+	// Zones of the moving cars, without reservations
+	conflict_matrix::zone_mask occupied = 0;
+	// Only when reserving tiles
+	std::unique_ptr<reservation_manager> reservations;
+	// Indexed by the slot of the session token, only process_requests()
+	// touches it
+	std::array<car, slot_mux::MAX_SLOTS> cars = {};
+	std::chrono::nanoseconds standby_timeout;
+	const tdma::timing_table *timing;
+	// A clear freed zones since the last admission
+	bool zones_freed = false;
+	std::atomic<uint64_t> admitted = 0;
+	// Guards events
 	std::mutex lock;
+	std::condition_variable cond;
+	std::deque<event> events;
 };
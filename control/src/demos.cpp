@@ -6,16 +6,28 @@
 
 #include <algorithm>
 #include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <future>
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <sstream>
+#include <string>
+#include <thread>
 #include <vector>
 
 #include <driver/device.hpp>
 #include <driver/drf7020d20.hpp>
 #include <driver/pinmap.hpp>
+#include <shared/airv2.hpp>
+#include <shared/arq.hpp>
+#include <shared/contention.hpp>
+#include <shared/framecheck.hpp>
 #include <shared/menu.hpp>
 #include <shared/messages.hpp>
+#include <shared/simradio.hpp>
 #include <shared/tdma.hpp>
 #include <shared/utils.hpp>
 
@@ -28,10 +40,38 @@ static void control_template(std::function<void(std::shared_ptr<drf7020d20>,
 		tdma::scheme,
 		std::atomic<bool> &)> inner_func);
 static void message_worker_test();
+static void sim_load_test();
+static bool virtual_car(const std::shared_ptr<sim_medium> &medium,
+	tdma::scheme div,
+	tdma::timing_mode mode,
+	frame_coding coding,
+	uint32_t slot,
+	uint32_t number,
+	std::atomic<uint64_t> &retransmissions);
+static bool virtual_car_v2(const std::shared_ptr<tdma> &car_slot,
+	const tdma *car_beacon,
+	uint32_t position,
+	uint32_t exit,
+	std::chrono::milliseconds drive_time,
+	std::atomic<uint64_t> &retransmissions);
+static uint32_t virtual_exit(
+	uint32_t position, uint32_t number, uint32_t positions);
+static bool virtual_await_go(const tdma &car_beacon, uint32_t slot);
+static std::chrono::milliseconds virtual_drive_time(
+	uint32_t position, uint32_t exit, uint32_t positions);
+
+// Attempts of a virtual car sent away before it gives up
+static constexpr uint32_t SIM_CAR_TRIES = 8;
+// Virtual cars clear within control's clear timeout of every timing
+static constexpr airv2::turn_times SIM_TURN_TIMES = {
+	.right = std::chrono::milliseconds(60),
+	.left = std::chrono::milliseconds(180),
+};
 
 static const std::vector<menu_item> demos = {
 	{.text = "TDMA control", .action = &tdma_control},
-	{.text = "Message worker", .action = &message_worker_test}};
+	{.text = "Message worker", .action = &message_worker_test},
+	{.text = "Simulated load test", .action = &sim_load_test}};
 
 void demo_submenu() {
 	show_menu("Control Demos", demos, true);
@@ -155,6 +195,11 @@ void tdma_control() {
 				tdma.tx_sync(*get_id());
 			}
 		}
+
+		// Slots finish together, keep reports apart
+		static std::mutex print_lock;
+		std::lock_guard<std::mutex> guard(print_lock);
+		tdma.print_timing(stdout);
 	};
 
 	control_template(inner_func);
@@ -183,7 +228,7 @@ void message_worker_test() {
 			std::cout << "Received check-in:\n\n";
 			printf("Current Position: %u\n", std::get<0>(request_data.value()));
 			printf("Desired Position: %u\n", std::get<1>(request_data.value()));
-			printf("Car Id: %s\n", std::get<2>(request_data.value()).c_str());
+			printf("Session: 0x%02x\n", std::get<2>(request_data.value()));
 
 			std::cout << "Processing request...\n";
 			worker.send_go_requested();
@@ -200,3 +245,341 @@ void message_worker_test() {
 
 	control_template(inner_func);
 }
+
+/**
+ * @brief Run the controller against virtual cars on a simulated channel.
+ *
+ */
+void sim_load_test() {
+	std::string input;
+
+	uint32_t n_cars = 16;
+	std::cout << "Virtual cars (default - 16): ";
+	std::getline(std::cin, input);
+	if (!input.empty()) {
+		n_cars = std::stoul(input);
+	}
+
+	double loss = 0.0;
+	std::cout << "Frame loss percent (default - 0): ";
+	std::getline(std::cin, input);
+	if (!input.empty()) {
+		loss = std::stod(input) / 100.0;
+	}
+
+	double corruption = 0.0;
+	std::cout << "Frame corruption percent (default - 0): ";
+	std::getline(std::cin, input);
+	if (!input.empty()) {
+		corruption = std::stod(input) / 100.0;
+	}
+
+	tdma::scheme div = tdma::AIR_A;
+	std::cout << "Scheme A, B or C (default - A): ";
+	std::getline(std::cin, input);
+	if (input == "B" || input == "b") {
+		div = tdma::AIR_B;
+	} else if (input == "C" || input == "c") {
+		div = tdma::AIR_C;
+	}
+	uint32_t n_slots = tdma::slot_count(div);
+
+	tdma::timing_mode mode = tdma::LEGACY;
+	std::cout << "Use 20 ms spec timeslots? (y/N): ";
+	std::getline(std::cin, input);
+	if (input == "y" || input == "Y") {
+		mode = tdma::SPEC;
+		std::cout << "Use control beacon? (y/N): ";
+		std::getline(std::cin, input);
+		if (input == "y" || input == "Y") {
+			mode = tdma::SPEC_BEACON;
+			std::cout << "Request slots in the contention slot? (y/N): ";
+			std::getline(std::cin, input);
+			if (input == "y" || input == "Y") {
+				mode = tdma::SPEC_DYNAMIC;
+			}
+		}
+	}
+
+	std::optional<std::chrono::nanoseconds> start_slack;
+	std::cout << "Reserve zones by turn times instead of locking paths? (y/N): ";
+	std::getline(std::cin, input);
+	if (input == "y" || input == "Y") {
+		// On a clean channel the go goes out in the car's next slot and
+		// is read off the radio within two more slots. Shorter than the
+		// go's retries, so tiles run out before the clear comes in.
+		const auto &table = tdma::get_table(div, mode);
+		start_slack = table.frame_duration + table.slot_duration * 3;
+	}
+
+	frame_coding coding = FRAME_CRC;
+	std::cout << "Use forward error correction? (y/N): ";
+	std::getline(std::cin, input);
+	if (input == "y" || input == "Y") {
+		coding = FRAME_FEC;
+	}
+
+	auto medium = std::make_shared<sim_medium>(9600, loss, corruption);
+	auto control_rf = std::make_shared<sim_transport>(medium);
+	set_link_coding(control_rf, coding);
+
+	// One entrance per slot
+	auto control = std::make_unique<controller>(
+		control_rf, n_slots, div, mode, start_slack);
+	auto control_thread = std::thread([&control]() {
+		while (control->is_active()) {
+			control->process_requests();
+		}
+	});
+
+	// Car side, cars queue up at their entrance, one at a time each
+	std::atomic<bool> active = true;
+	std::atomic<uint32_t> completed = 0;
+	std::atomic<uint32_t> sent_away = 0;
+	std::atomic<uint64_t> retransmissions = 0;
+	auto car_executor = [&](uint32_t slot) {
+		for (uint32_t i = slot; i < n_cars && active; i += n_slots) {
+			// Cars sent away without a beacon queue up again
+			for (uint32_t tries = 0; tries < SIM_CAR_TRIES && active;
+				tries++) {
+				if (virtual_car(
+						medium, div, mode, coding, slot, i, retransmissions)) {
+					completed++;
+					break;
+				}
+				sent_away++;
+			}
+		}
+	};
+
+	std::cout << "Running " << n_cars << " virtual cars. Hit space to stop\n";
+	auto start = std::chrono::steady_clock::now();
+
+	std::vector<std::thread> car_threads;
+	for (uint32_t slot = 0; slot < n_slots; slot++) {
+		car_threads.emplace_back(car_executor, slot);
+	}
+
+	auto exit_future = std::async(std::launch::async, [&active]() {
+		raw_tty();
+		while (active && std::getchar() != ' ') {
+		}
+		active = false;
+	});
+
+	for (auto &thread : car_threads) {
+		thread.join();
+	}
+	auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now() - start);
+
+	std::cout << "Cars done, hit space to return\n";
+	exit_future.wait();
+	control->stop();
+	control_thread.join();
+	restore_tty();
+
+	auto stats = medium->get_stats();
+	auto minutes = (double)elapsed.count() / 60000.0;
+	printf("Cars through: %u/%u, attempts sent away: %u\n", completed.load(),
+		n_cars, sent_away.load());
+	printf("Elapsed: %lld ms, throughput: %.1f cars/min\n",
+		(long long)elapsed.count(), completed.load() / minutes);
+	printf("Frames sent: %llu, delivered: %llu, collided: %llu, lost: %llu\n",
+		(unsigned long long)stats.sent, (unsigned long long)stats.delivered,
+		(unsigned long long)stats.collided, (unsigned long long)stats.lost);
+	printf("Frames corrupted: %llu, control rejected: %llu, repaired: %llu, "
+		   "unchecked: %llu\n",
+		(unsigned long long)stats.corrupted,
+		(unsigned long long)control_rf->get_rejected(),
+		(unsigned long long)control_rf->get_repaired(),
+		(unsigned long long)get_unchecked_frames(control_rf));
+	printf("AIRv2 retransmissions: %llu\n",
+		(unsigned long long)retransmissions.load());
+	control->print_stats(stdout);
+
+	// Joins the control workers
+	control.reset();
+	prompt_enter();
+}
+
+/**
+ * @brief Get the exit of a virtual car.
+ * @note Cars take every movement but a U-turn in turn.
+ *
+ * @param[in] position - Entrance.
+ * @param[in] number - Car number.
+ * @param[in] positions - Intersection size.
+ * @return Requested position.
+ */
+uint32_t virtual_exit(uint32_t position, uint32_t number, uint32_t positions) {
+	return (position + 1 + number % (positions - 1)) % positions;
+}
+
+/**
+ * @brief Get the time a virtual car takes through the intersection.
+ * @note Same pace as reservation_manager::plan_movement().
+ *
+ * @param[in] position - Entrance.
+ * @param[in] exit - Requested position, not the entrance.
+ * @param[in] positions - Intersection size.
+ * @return Time from the go to the clear.
+ */
+std::chrono::milliseconds virtual_drive_time(
+	uint32_t position, uint32_t exit, uint32_t positions) {
+	uint32_t zones = (exit + positions - position) % positions;
+	if (zones == 1) {
+		return SIM_TURN_TIMES.right;
+	}
+	return SIM_TURN_TIMES.left * zones / (positions - 1);
+}
+
+/**
+ * @brief Wait for the beacon to announce go for a slot.
+ *
+ * @param[in] car_beacon - Beacon slot of the car.
+ * @param[in] slot - Car timeslot.
+ * @return True if the go came within airv2::STANDBY_BEACONS beacons.
+ */
+bool virtual_await_go(const tdma &car_beacon, uint32_t slot) {
+	for (uint32_t i = 0; i < airv2::STANDBY_BEACONS; i++) {
+		rf_transport::frame rx_frame;
+		if (!car_beacon.rx_sync(rx_frame, 1)) {
+			continue;
+		}
+
+		auto msg = airv2::decode(rx_frame.bytes());
+		if (msg.has_value() && airv2::get_type(*msg) == airv2::BEACON &&
+			airv2::get_slot_state(*msg, slot) == airv2::GO_REQUESTED) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * @brief Run one negotiation as a car.
+ * @note Odd numbered cars speak AIRv2, the rest AIRv1.0. With SPEC_DYNAMIC
+ * timing every car asks for a slot and speaks AIRv2. Cars told to stand by
+ * wait for the go in the beacon, without one they clear and leave. Cars
+ * that go clear after driving for their turn time, see SIM_TURN_TIMES.
+ *
+ * @param[in] medium - Simulated channel.
+ * @param[in] div - TDMA scheme.
+ * @param[in] mode - Slot timing.
+ * @param[in] coding - Frame coding.
+ * @param[in] slot - Car timeslot & position, only position if dynamic.
+ * @param[in] number - Car number for its ID and exit.
+ * @param[in,out] retransmissions - AIRv2 retransmission count.
+ * @return True if the car got through the intersection.
+ */
+bool virtual_car(const std::shared_ptr<sim_medium> &medium,
+	tdma::scheme div,
+	tdma::timing_mode mode,
+	frame_coding coding,
+	uint32_t slot,
+	uint32_t number,
+	std::atomic<uint64_t> &retransmissions) {
+	auto car_rf = std::make_shared<sim_transport>(medium);
+	auto car_tdma = std::make_shared<tdma>(car_rf, slot, div, mode);
+	car_tdma->set_coding(coding);
+	std::unique_ptr<tdma> car_beacon;
+	if (tdma::get_table(div, mode).has_beacon) {
+		car_beacon =
+			std::make_unique<tdma>(car_rf, tdma::beacon_slot(div), div, mode);
+	}
+	if (mode == tdma::SPEC_DYNAMIC &&
+		!request_slot(*car_tdma, *car_beacon, slot).has_value()) {
+		return false;
+	}
+
+	uint32_t exit = virtual_exit(slot, number, tdma::slot_count(div));
+	if (number % 2 == 1 || mode == tdma::SPEC_DYNAMIC) {
+		return virtual_car_v2(car_tdma, car_beacon.get(), slot, exit,
+			virtual_drive_time(slot, exit, tdma::slot_count(div)),
+			retransmissions);
+	}
+
+	tdma &car_slot = *car_tdma;
+
+	car_slot.tx_sync("AIRv1.0 CHK");
+	// Control ID, then the offset after the last space
+	auto reply = car_slot.rx_sync(4);
+	auto split = reply.rfind(' ');
+	if (split == std::string::npos || !validate_id(reply.substr(0, split)) ||
+		!parse_offset(reply.substr(split + 1)).has_value()) {
+		return false;
+	}
+
+	// Positions are one character each, as the car sends them
+	char request[rf_transport::FRAME_SIZE + 1] = {};
+	std::snprintf(request, sizeof(request), "SIM%u %c%c", number % 10000,
+		(char)(slot + '0'), (char)(exit + '0'));
+	car_slot.tx_sync(request);
+	auto command = car_slot.rx_sync(4);
+	if (command.rfind("ACK", 0) != 0) {
+		return false;
+	}
+
+	car_slot.tx_sync("ACK");
+	bool go = command == "ACK GRQ";
+	if (!go && car_beacon != nullptr) {
+		go = virtual_await_go(*car_beacon, slot);
+	}
+	if (go) {
+		std::this_thread::sleep_for(
+			virtual_drive_time(slot, exit, tdma::slot_count(div)));
+	}
+	car_slot.tx_sync("CLR");
+	return car_slot.rx_sync(4) == "ACK FIN" && go;
+}
+
+/**
+ * @brief Run one AIRv2 negotiation as a car.
+ * @note The request carries SIM_TURN_TIMES for reservations.
+ *
+ * @param[in] car_slot - Car timeslot.
+ * @param[in] car_beacon - Beacon slot, nullptr without a beacon.
+ * @param[in] position - Car position.
+ * @param[in] exit - Requested position.
+ * @param[in] drive_time - Time from the go to the clear.
+ * @param[in,out] retransmissions - Retransmission count.
+ * @return True if the car got through the intersection.
+ */
+bool virtual_car_v2(const std::shared_ptr<tdma> &car_slot,
+	const tdma *car_beacon,
+	uint32_t position,
+	uint32_t exit,
+	std::chrono::milliseconds drive_time,
+	std::atomic<uint64_t> &retransmissions) {
+	arq_session arq(car_slot);
+	uint32_t slot = car_slot->get_timeslot();
+
+	auto reply = arq.check_in(format_header(AIRV2) + " CHK");
+	if (!reply.has_value() || airv2::session_slot(reply->session) != slot) {
+		retransmissions += arq.get_retransmissions();
+		return false;
+	}
+
+	auto request =
+		airv2::make(airv2::REQUEST, 0, 0, airv2::positions(position, exit));
+	airv2::set_turn_times(request, SIM_TURN_TIMES);
+	auto command = arq.request(request, airv2::COMMAND);
+	bool go = false;
+	std::optional<airv2::frame> final;
+	if (command.has_value()) {
+		arq.post(airv2::make(airv2::ACKNOWLEDGE, 0, 0, 0));
+		go = command->arg == airv2::GO_REQUESTED;
+		if (!go && car_beacon != nullptr) {
+			go = virtual_await_go(*car_beacon, slot);
+		}
+		if (go) {
+			std::this_thread::sleep_for(drive_time);
+		}
+		final = arq.request(
+			airv2::make(airv2::CLEAR, 0, 0, 0), airv2::COMMAND);
+	}
+
+	retransmissions += arq.get_retransmissions();
+	return go && final.has_value() && final->arg == airv2::FINAL;
+}
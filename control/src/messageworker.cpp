@@ -5,12 +5,14 @@
 
 #include "messageworker.hpp"
 
+#include <array>
 #include <chrono>
 #include <fstream>
 #include <iostream>
 #include <sstream>
 #include <stdexcept>
 
+#include <shared/airv2.hpp>
 #include <shared/messages.hpp>
 
 static constexpr std::string MSG_HEADER = "AIRv1.0";
@@ -24,28 +26,46 @@ static constexpr std::string FINAL = "FIN";
 
 static constexpr uint8_t MESSAGE_TIMEOUT =
 	4; /*amount of time to wait for message (in frames)*/
+static constexpr uint32_t ARQ_TIMEOUT =
+	2 * arq_session::MAX_TRIES; /*car retries each attempt once a frame*/
 
 message_worker::message_worker(const std::shared_ptr<tdma> &tdma_handler_in,
 	std::atomic<bool> &active_flag_in)
 	: active_flag(active_flag_in),
 	  tdma_handler(tdma_handler_in),
-	  control_id(get_id()) {}
+	  control_id(get_id()),
+	  arq(tdma_handler_in) {}
 
-std::optional<std::tuple<uint8_t, uint8_t, std::string>>
+message_worker::~message_worker() {
+	if (thread != nullptr) {
+		thread->join();
+	}
+}
+
+std::optional<std::tuple<uint8_t, uint8_t, uint8_t>>
 message_worker::await_request_sync() {
 	while (active_flag) {
-		std::string rx_msg = tdma_handler->rx_sync(MESSAGE_TIMEOUT);
-		if (rx_msg.empty()) {
+		rf_transport::frame rx_frame;
+		if (!tdma_handler->rx_sync(rx_frame, MESSAGE_TIMEOUT)) {
 			continue;
 		}
 
+		// Check in is always ASCII, AIRv2 messages are leftovers of the
+		// last session, e.g. a clear whose final got lost
+		if (airv2::is_airv2(rx_frame.bytes())) {
+			arq.answer_repeat(rx_frame);
+			continue;
+		}
+		std::string rx_msg(rx_frame.view());
+
 		std::istringstream parts(rx_msg);
 		std::string header;
 		std::string check;
 
 		parts >> header;
 
-		if (parts.eof() || !validate_header(header)) {
+		auto requested = validate_header(header);
+		if (parts.eof() || !requested.has_value()) {
 			continue;
 		}
 
@@ -54,9 +74,21 @@ message_worker::await_request_sync() {
 			continue;
 		}
 
-		tdma_handler->tx_sync(*control_id);
+		// New session for whoever is in the slot now
+		version = *requested;
+		arq.reset(airv2::make_session(get_timeslot(), sessions_started++));
+
+		// Report how far off the car's transmission start was
+		auto offset = tdma_handler->get_arrival_error();
+		if (version == AIRV2) {
+			// Repeated check ins get the same reply
+			arq.reply(
+				make_frame(airv2::CONTROL_ID, airv2::pack_offset(offset)));
+		} else {
+			tdma_handler->tx_sync(*control_id + " " + format_offset(offset));
+		}
 
-		std::optional<std::tuple<uint8_t, uint8_t, std::string>> request_data =
+		std::optional<std::tuple<uint8_t, uint8_t, uint8_t>> request_data =
 			get_request();
 		if (!request_data.has_value()) {
 			continue;
@@ -68,13 +100,14 @@ message_worker::await_request_sync() {
 }
 
 void message_worker::await_request(
-	std::function<void(uint8_t, uint8_t, std::string &, message_worker &)>
+	std::function<void(uint8_t, uint8_t, uint8_t, message_worker &)>
 		callback) {
 	if (thread != nullptr) {
 		thread->join();
 		thread.reset();
 	}
-	auto executor = [&]() {
+	// Callers return before the thread is done with the callback
+	auto executor = [this, callback]() {
 		auto request_data = await_request_sync();
 		if (!request_data.has_value()) {
 			return;
@@ -88,8 +121,20 @@ void message_worker::await_request(
 	thread = std::make_unique<std::thread>(executor);
 }
 
-std::optional<std::tuple<uint8_t, uint8_t, std::string>>
+std::optional<std::tuple<uint8_t, uint8_t, uint8_t>>
 message_worker::get_request() {
+	turn_times.reset();
+	if (version == AIRV2) {
+		auto request = receive_frame(airv2::REQUEST);
+		if (!request.has_value()) {
+			return std::nullopt;
+		}
+
+		turn_times = airv2::get_turn_times(*request);
+		return std::make_tuple(airv2::current_pos(request->arg),
+			airv2::desired_pos(request->arg), get_session());
+	}
+
 	std::string rx_msg = tdma_handler->rx_sync(MESSAGE_TIMEOUT);
 	std::cout << "Received Message: " << rx_msg << std::endl;
 
@@ -109,10 +154,20 @@ message_worker::get_request() {
 	std::cout << "Current Pos: " << rx_msg << std::endl;
 	std::cout << "Desired Pos: " << rx_msg << std::endl;
 
-	return std::make_tuple(current_pos, desired_pos, car_id);
+	return std::make_tuple(current_pos, desired_pos, get_session());
 }
 
 bool message_worker::await_clear_sync() {
+	if (version == AIRV2) {
+		if (!receive_frame(airv2::CLEAR).has_value()) {
+			std::cout << "Clear was not received. Clearing anyway...\n";
+			return false;
+		}
+
+		send_command(airv2::FINAL);
+		return true;
+	}
+
 	std::string rx_msg = tdma_handler->rx_sync(MESSAGE_TIMEOUT);
 
 	if (rx_msg.empty() || rx_msg != CLEAR) {
@@ -130,7 +185,7 @@ void message_worker::await_clear(
 		thread->join();
 		thread.reset();
 	}
-	auto executor = [&]() {
+	auto executor = [this, callback]() {
 		bool sent_clear = await_clear_sync();
 
 		callback(sent_clear, *this);
@@ -145,24 +200,63 @@ void message_worker::send_checkin() {
 }
 
 void message_worker::send_unsupported() {
+	if (version == AIRV2) {
+		arq.reply(make_frame(airv2::UNSUPPORTED, 0));
+		return;
+	}
+
+	// Runs on the controller's thread, the scheduler sends it in our slot
 	std::string unsupported_msg = UNSUPPORTED + " " + *control_id;
-	tdma_handler->tx_sync(unsupported_msg);
+	tdma_handler->tx_async(unsupported_msg);
 }
 
 void message_worker::send_command(const std::string &command) {
+	// Nothing to wait for, the scheduler sends it in our slot
 	std::string command_msg = ACKNOWLEDGE + " " + command;
-	tdma_handler->tx_sync(command_msg);
+	tdma_handler->tx_async(command_msg);
+}
+
+void message_worker::send_command(airv2::command command) {
+	// Keep the car's slot clock on track for the rest of the session
+	auto msg = airv2::make(airv2::COMMAND, 0, 0, command);
+	airv2::set_feedback(msg, tdma_handler->get_arrival_error());
+	arq.reply(msg);
 }
 
 void message_worker::send_standby() {
+	if (version == AIRV2) {
+		send_command(airv2::STANDBY);
+		return;
+	}
+
 	send_command(STANDBY);
 }
 
 void message_worker::send_go_requested() {
+	if (version == AIRV2) {
+		send_command(airv2::GO_REQUESTED);
+		return;
+	}
+
 	send_command(GO_REQUESTED);
 }
 
 bool message_worker::check_acknowledge_sync() {
+	if (version == AIRV2) {
+		auto msg = arq.receive(ARQ_TIMEOUT);
+		if (!msg.has_value()) {
+			return false;
+		}
+
+		// The car only clears after the acknowledge, so it got lost on
+		// the way. Keep the clear for await_clear_sync().
+		if (airv2::get_type(*msg) == airv2::CLEAR) {
+			arq.hold(*msg);
+			return true;
+		}
+		return airv2::get_type(*msg) == airv2::ACKNOWLEDGE;
+	}
+
 	std::string ack_msg = tdma_handler->rx_sync(MESSAGE_TIMEOUT);
 	std::cout << "ACK MSG: " << ack_msg << std::endl;
 	return ack_msg == ACKNOWLEDGE;
@@ -174,7 +268,7 @@ void message_worker::check_acknowledge(
 		thread->join();
 		thread.reset();
 	}
-	auto executor = [&]() {
+	auto executor = [this, callback]() {
 		bool received_ack = check_acknowledge_sync();
 
 		// hamdle if request data is std::null_opt
@@ -183,3 +277,27 @@ void message_worker::check_acknowledge(
 
 	thread = std::make_unique<std::thread>(executor);
 }
+
+std::optional<airv2::frame> message_worker::receive_frame(airv2::type kind) {
+	// Frames of earlier sessions in this slot are filtered out already
+	auto msg = arq.receive(ARQ_TIMEOUT);
+
+	// Acknowledges are not always waited for
+	if (msg.has_value() && kind != airv2::ACKNOWLEDGE &&
+		airv2::get_type(*msg) == airv2::ACKNOWLEDGE) {
+		msg = arq.receive(ARQ_TIMEOUT);
+	}
+
+	if (!msg.has_value() || airv2::get_type(*msg) != kind) {
+		return std::nullopt;
+	}
+
+	return msg;
+}
+
+airv2::frame message_worker::make_frame(airv2::type kind, uint8_t arg) {
+	// Session and sequence number are filled in when sent
+	auto msg = airv2::make(kind, 0, 0, arg);
+	airv2::set_id(msg, *control_id);
+	return msg;
+}
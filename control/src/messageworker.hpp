@@ -12,6 +12,9 @@
 #include <thread>
 #include <tuple>
 
+#include <shared/airv2.hpp>
+#include <shared/arq.hpp>
+#include <shared/messages.hpp>
 #include <shared/tdma.hpp>
 
 class message_worker {
@@ -23,11 +26,18 @@ public:
 	message_worker(const std::shared_ptr<tdma> &tdma_handler_in,
 		std::atomic<bool> &active_flag_in);
 
+	message_worker(message_worker &&) = default;
+
+	/**
+	 * @brief waits for the running exchange to end
+	 */
+	~message_worker();
+
 	/**
 	 * @brief awaits request form car synchronously
 	 * @return true if check in is sent successfully
 	 */
-	std::optional<std::tuple<uint8_t, uint8_t, std::string>>
+	std::optional<std::tuple<uint8_t, uint8_t, uint8_t>>
 	await_request_sync();
 
 	/**
@@ -36,14 +46,14 @@ public:
 	 * @param[in] callback
 	 */
 	void await_request(
-		std::function<void(uint8_t, uint8_t, std::string &, message_worker &)>
+		std::function<void(uint8_t, uint8_t, uint8_t, message_worker &)>
 			callback);
 
 	/**
 	 * @brief receives request from car
-	 * @return pair of current and desired position of car
+	 * @return current and desired position of car, session token
 	 */
-	std::optional<std::tuple<uint8_t, uint8_t, std::string>> get_request();
+	std::optional<std::tuple<uint8_t, uint8_t, uint8_t>> get_request();
 
 	/**
 	 * @brief receives clear message from car and ends conversation
@@ -99,6 +109,30 @@ public:
 		return tdma_handler->get_timeslot();
 	}
 
+	/**
+	 * @brief get session token of the car in the slot
+	 * @return token assigned at the last check in, 0 before any
+	 */
+	inline uint8_t get_session() const {
+		return arq.get_session();
+	}
+
+	/**
+	 * @brief get the turn times of the last request
+	 * @return turn times, std::nullopt if the car sent none
+	 */
+	inline std::optional<airv2::turn_times> get_turn_times() const {
+		return turn_times;
+	}
+
+	/**
+	 * @brief get retransmission statistics of the slot
+	 * @return ARQ state of the current session
+	 */
+	inline const arq_session &get_arq() const {
+		return arq;
+	}
+
 private:
 	/**
 	 * @param command response to car's request
@@ -106,9 +140,38 @@ private:
 	 */
 	void send_command(const std::string &command);
 
+	/**
+	 * @param command response to car's request
+	 * @brief creates AIRv2 command message
+	 */
+	void send_command(airv2::command command);
+
+	/**
+	 * @brief receives next new AIRv2 message of the session
+	 * @note repeated messages are answered meanwhile
+	 * @param[in] kind expected message type
+	 * @return message, std::nullopt on timeout or anything else received
+	 */
+	std::optional<airv2::frame> receive_frame(airv2::type kind);
+
+	/**
+	 * @brief creates AIRv2 message carrying control id
+	 * @param[in] kind message type
+	 * @param[in] arg message argument
+	 * @return message
+	 */
+	airv2::frame make_frame(airv2::type kind, uint8_t arg);
+
 	std::unique_ptr<std::thread> thread;
 	// NOLINTNEXTLINE
 	std::atomic<bool> &active_flag;
 	std::shared_ptr<tdma> tdma_handler;
 	std::shared_ptr<std::string> control_id;
+	// Negotiated at check in
+	protocol_version version = AIRV1;
+	uint32_t sessions_started = 0;
+	// Sequence numbers & replies of the session
+	arq_session arq;
+	// AIRv2 requests only
+	std::optional<airv2::turn_times> turn_times;
 };
@@ -0,0 +1,127 @@
+/**
+ * @file src/reservations.cpp
+ * @brief time-space reservations of the intersection zones
+ */
+#include "reservations.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <optional>
+
+/**
+ * @brief check if two plans cross a zone in common
+ * @param[in] lhs
+ * @param[in] rhs
+ * @return true if any zone is in both, at any time
+ */
+static bool shares_zone(
+	const reservation_manager::plan &lhs, const reservation_manager::plan &rhs) {
+	for (const auto &left : lhs) {
+		for (const auto &right : rhs) {
+			if (left.zone == right.zone) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+reservation_manager::reservation_manager(
+	const conflict_matrix &conflicts_in,
+	std::chrono::nanoseconds start_slack_in)
+	: conflicts(conflicts_in),
+	  start_slack(start_slack_in) {}
+
+reservation_manager::plan reservation_manager::plan_movement(uint8_t entry,
+	uint8_t exit,
+	const std::optional<airv2::turn_times> &times,
+	slot_clock::time_point start) const {
+	uint32_t positions = conflicts.get_positions();
+	auto length = (uint32_t)std::popcount(conflicts.zones(entry, exit));
+
+	// A right turn crosses one zone, a left one every zone but one, the
+	// rest take the left turn's pace
+	std::chrono::nanoseconds duration(0);
+	if (times.has_value()) {
+		if (length == 1 || positions < 2) {
+			duration = times->right * length;
+		} else {
+			duration = times->left * length / (positions - 1);
+		}
+	}
+
+	plan tiles;
+	for (uint32_t i = 0; i < length; i++) {
+		auto zone = (uint8_t)((entry + i) % positions);
+		if (!times.has_value()) {
+			tiles.tiles[tiles.count++] = {
+				.zone = zone,
+				.start = start,
+				.end = slot_clock::time_point::max(),
+			};
+			continue;
+		}
+
+		// The car may start up to start_slack late
+		tiles.tiles[tiles.count++] = {
+			.zone = zone,
+			.start = start + duration * i / length,
+			.end = start + duration * (i + 1) / length + start_slack,
+		};
+	}
+	return tiles;
+}
+
+bool reservation_manager::is_free(const plan &tiles) const {
+	return std::none_of(reserved.begin(), reserved.end(),
+		[&tiles](const plan &other) {
+			return overlap(tiles, other);
+		});
+}
+
+void reservation_manager::reserve(uint32_t slot, const plan &tiles) {
+	if (slot < reserved.size()) {
+		bool sharing = std::any_of(reserved.begin(), reserved.end(),
+			[&tiles](const plan &other) {
+				return shares_zone(tiles, other);
+			});
+		if (sharing) {
+			shared++;
+		}
+		reserved[slot] = tiles;
+	}
+}
+
+void reservation_manager::release(uint32_t slot) {
+	if (slot < reserved.size()) {
+		reserved[slot].count = 0;
+	}
+}
+
+bool reservation_manager::expire(slot_clock::time_point now) {
+	bool dropped = false;
+	for (auto &tiles : reserved) {
+		auto *first = tiles.tiles.data();
+		auto *over = std::remove_if(first, first + tiles.count,
+			[now](const tile &curr) {
+				return curr.end <= now;
+			});
+		dropped |= over != tiles.end();
+		tiles.count = (uint32_t)(over - first);
+	}
+	return dropped;
+}
+
+std::optional<slot_clock::time_point> reservation_manager::next_end() const {
+	std::optional<slot_clock::time_point> next;
+	for (const auto &tiles : reserved) {
+		for (const auto &curr : tiles) {
+			if (curr.end != slot_clock::time_point::max() &&
+				(!next.has_value() || curr.end < *next)) {
+				next = curr.end;
+			}
+		}
+	}
+	return next;
+}
@@ -0,0 +1,152 @@
+/**
+ * @file src/reservations.hpp
+ * @brief time-space reservations of the intersection zones
+ */
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+
+#include <shared/airv2.hpp>
+#include <shared/slotclock.hpp>
+#include <shared/slotmux.hpp>
+
+#include "conflicts.hpp"
+
+class reservation_manager {
+public:
+	// One zone for a stretch of time
+	struct tile {
+		uint8_t zone;
+		slot_clock::time_point start;
+		slot_clock::time_point end;
+	};
+
+	// Tiles in the order the car crosses them, every zone at most once
+	struct plan {
+		std::array<tile, conflict_matrix::MAX_POSITIONS> tiles;
+		uint32_t count = 0;
+
+		constexpr const tile *begin() const {
+			return tiles.data();
+		}
+
+		constexpr const tile *end() const {
+			return tiles.data() + count;
+		}
+	};
+
+	/**
+	 * @brief constructor
+	 * @param[in] conflicts_in zones of the movements
+	 * @param[in] start_slack_in how late a car may start after its go
+	 */
+	reservation_manager(const conflict_matrix &conflicts_in,
+		std::chrono::nanoseconds start_slack_in);
+
+	/**
+	 * @brief lay out the tiles of a movement
+	 * @note zones are crossed one after another in equal shares of the
+	 * movement's time. Without turn times the car holds every zone until
+	 * its clear.
+	 * @param[in] entry current position of the car, must be valid
+	 * @param[in] exit requested position, must be valid
+	 * @param[in] times turn times the car sent
+	 * @param[in] start time of the go
+	 * @return tiles in the order the car crosses them
+	 */
+	plan plan_movement(uint8_t entry,
+		uint8_t exit,
+		const std::optional<airv2::turn_times> &times,
+		slot_clock::time_point start) const;
+
+	/**
+	 * @brief check a plan against the reserved tiles
+	 * @param[in] tiles
+	 * @return true if no reserved tile overlaps
+	 */
+	bool is_free(const plan &tiles) const;
+
+	/**
+	 * @brief check two plans against each other
+	 * @note tiles are half open, one may start as another ends
+	 * @param[in] lhs
+	 * @param[in] rhs
+	 * @return true if a tile of one overlaps a tile of the other
+	 */
+	static constexpr bool overlap(const plan &lhs, const plan &rhs) {
+		for (const auto &left : lhs) {
+			for (const auto &right : rhs) {
+				if (left.zone == right.zone && left.start < right.end &&
+					right.start < left.end) {
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	/**
+	 * @brief reserve the tiles of a car
+	 * @param[in] slot timeslot of the car
+	 * @param[in] tiles
+	 */
+	void reserve(uint32_t slot, const plan &tiles);
+
+	/**
+	 * @brief drop the tiles of a car once it cleared
+	 * @param[in] slot timeslot of the car
+	 */
+	void release(uint32_t slot);
+
+	/**
+	 * @brief drop tiles that are over
+	 * @param[in] now
+	 * @return true if any were dropped
+	 */
+	bool expire(slot_clock::time_point now);
+
+	/**
+	 * @brief get the time the next reserved tile is over
+	 * @return end of the earliest tile, std::nullopt if none will be
+	 */
+	std::optional<slot_clock::time_point> next_end() const;
+
+	/**
+	 * @brief get the number of cars reserved into a zone another car
+	 * still holds a tile in, which path locking would have held back
+	 * @return reservation count
+	 */
+	inline uint64_t get_shared() const {
+		return shared;
+	}
+
+private:
+	// NOLINTNEXTLINE
+	const conflict_matrix &conflicts;
+	std::chrono::nanoseconds start_slack;
+	// Indexed by timeslot
+	std::array<plan, slot_mux::MAX_SLOTS> reserved;
+	uint64_t shared = 0;
+};
+
+// Back-to-back tiles in one zone do not conflict, so both cars go
+static_assert([]() {
+	auto start = slot_clock::time_point();
+	auto tile_time = std::chrono::milliseconds(100);
+	reservation_manager::plan first = {};
+	first.tiles[first.count++] = {
+		.zone = 1, .start = start, .end = start + tile_time};
+	reservation_manager::plan second = {};
+	second.tiles[second.count++] = {
+		.zone = 2, .start = start, .end = start + tile_time};
+	second.tiles[second.count++] = {
+		.zone = 1, .start = start + tile_time, .end = start + 2 * tile_time};
+	reservation_manager::plan early = second;
+	early.tiles[1].start -= std::chrono::milliseconds(1);
+	return !reservation_manager::overlap(first, second) &&
+		   !reservation_manager::overlap(second, first) &&
+		   reservation_manager::overlap(first, early);
+}(), "Reservation tiles in one zone");
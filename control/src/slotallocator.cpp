@@ -0,0 +1,151 @@
+/**
+ * @file src/slotallocator.cpp
+ * @brief assigns data slots to cars asking for one
+ */
+#include "slotallocator.hpp"
+
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+
+#include <driver/transport.hpp>
+#include <shared/airv2.hpp>
+#include <shared/arq.hpp>
+#include <shared/contention.hpp>
+#include <shared/slotclock.hpp>
+#include <shared/tdma.hpp>
+
+// Grant waits in the beacon queue, then the car retries its check in
+static constexpr uint32_t GRANT_TIMEOUT_FRAMES =
+	GRANT_FRAMES + 2 * arq_session::MAX_TRIES;
+
+slot_allocator::slot_allocator(const std::shared_ptr<slot_mux> &mux_in,
+	beacon &downlink_in,
+	std::atomic<bool> &active_flag_in)
+	: downlink(downlink_in),
+	  active_flag(active_flag_in),
+	  mux(mux_in),
+	  slot_count(tdma::slot_count(mux_in->get_scheme())) {
+	const auto &table =
+		tdma::get_table(mux_in->get_scheme(), mux_in->get_mode());
+	if (!table.has_contention) {
+		throw std::invalid_argument("Timing has no contention slot");
+	}
+
+	grant_timeout = table.frame_duration * GRANT_TIMEOUT_FRAMES;
+	slot_duration = table.slot_duration;
+	for (uint32_t slot = 0; slot < slot_count; slot++) {
+		answers[slot] = std::make_unique<tdma>(mux_in, slot);
+	}
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		publish();
+	}
+	thread = std::make_unique<std::thread>([this]() {
+		worker_loop();
+	});
+}
+
+slot_allocator::~slot_allocator() {
+	thread->join();
+}
+
+void slot_allocator::checked_in(uint32_t slot) {
+	std::lock_guard<std::mutex> guard(lock);
+	if (slot < slot_count) {
+		slots[slot] = {.state = ACTIVE, .since = slot_clock::clock::now()};
+		publish();
+	}
+}
+
+void slot_allocator::release(uint32_t slot) {
+	std::lock_guard<std::mutex> guard(lock);
+	if (slot < slot_count) {
+		slots[slot] = {.state = FREE, .since = slot_clock::clock::now()};
+		publish();
+	}
+}
+
+std::optional<uint32_t> slot_allocator::allocate(uint32_t wanted) {
+	std::lock_guard<std::mutex> guard(lock);
+	uint32_t chosen = wanted;
+	if (wanted >= slot_count) {
+		chosen = 0;
+		while (chosen < slot_count && slots[chosen].state != FREE) {
+			chosen++;
+		}
+	}
+	if (chosen >= slot_count || slots[chosen].state != FREE) {
+		return std::nullopt;
+	}
+
+	slots[chosen] = {.state = GRANTED, .since = slot_clock::clock::now()};
+	publish();
+	return chosen;
+}
+
+void slot_allocator::reclaim() {
+	std::lock_guard<std::mutex> guard(lock);
+	auto now = slot_clock::clock::now();
+	bool freed = false;
+	for (uint32_t slot = 0; slot < slot_count; slot++) {
+		if (slots[slot].state == GRANTED &&
+			now - slots[slot].since > grant_timeout) {
+			slots[slot].state = FREE;
+			freed = true;
+		}
+	}
+	if (freed) {
+		publish();
+	}
+}
+
+void slot_allocator::publish() {
+	uint16_t open = 0;
+	for (uint32_t slot = 0; slot < slot_count; slot++) {
+		if (slots[slot].state == FREE) {
+			open |= 1U << slot;
+		}
+	}
+	downlink.set_open_slots(open);
+}
+
+void slot_allocator::worker_loop() {
+	uint32_t contention = tdma::contention_slot(mux->get_scheme());
+	while (active_flag) {
+		reclaim();
+
+		// Requests sent in open slots are queued with the contention slot,
+		// see slot_mux, so answer after every slot rather than every frame
+		std::this_thread::sleep_for(slot_duration);
+
+		// Collisions never get here, the frame check drops them
+		rf_transport::frame rx_frame;
+		while (mux->pop(contention, rx_frame)) {
+			auto msg = airv2::decode(rx_frame.bytes());
+			if (!msg.has_value() || airv2::get_type(*msg) != airv2::REQUEST ||
+				msg->session != 0 || msg->seq == 0) {
+				continue;
+			}
+
+			// Refused cars back off and ask again
+			uint32_t wanted = mux->slot_at(rx_frame.arrival);
+			auto slot = allocate(wanted);
+			if (!slot.has_value()) {
+				refused++;
+				continue;
+			}
+
+			// Grants in the slot asked in take no room in the beacon
+			if (*slot == wanted) {
+				answers[*slot]->tx_async(airv2::encode(
+					airv2::make(airv2::CONTROL_ID, 0, msg->seq, (uint8_t)*slot)));
+			} else {
+				downlink.grant(msg->seq, *slot);
+			}
+			granted++;
+		}
+	}
+}
@@ -0,0 +1,117 @@
+/**
+ * @file src/slotallocator.hpp
+ * @brief assigns data slots to cars asking for one
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+#include <shared/slotclock.hpp>
+#include <shared/slotmux.hpp>
+#include <shared/tdma.hpp>
+
+#include "beacon.hpp"
+
+class slot_allocator {
+public:
+	/**
+	 * @brief constructor, starts answering slot requests
+	 * @note the multiplexer must use SPEC_DYNAMIC timing
+	 * @param[in] mux_in radio of control
+	 * @param[in] downlink_in beacon carrying the grants
+	 * @param[in] active_flag_in answering stops once cleared
+	 */
+	slot_allocator(const std::shared_ptr<slot_mux> &mux_in,
+		beacon &downlink_in,
+		std::atomic<bool> &active_flag_in);
+
+	~slot_allocator();
+
+	/**
+	 * @brief note that the granted car arrived in its slot
+	 * @param[in] slot timeslot
+	 */
+	void checked_in(uint32_t slot);
+
+	/**
+	 * @brief free a slot after clear or timeout
+	 * @param[in] slot timeslot
+	 */
+	void release(uint32_t slot);
+
+	/**
+	 * @brief get the number of slots granted
+	 * @return grant count
+	 */
+	inline uint64_t get_granted() const {
+		return granted;
+	}
+
+	/**
+	 * @brief get the number of requests refused for lack of a free slot
+	 * @return refusal count
+	 */
+	inline uint64_t get_refused() const {
+		return refused;
+	}
+
+private:
+	enum slot_state {
+		FREE,
+		// Announced, car has not checked in yet
+		GRANTED,
+		ACTIVE,
+	};
+
+	struct allocation {
+		slot_state state;
+		slot_clock::time_point since;
+	};
+
+	/**
+	 * @brief take the slot the car asked in, or the lowest free one if it
+	 * asked in the contention slot
+	 * @param[in] wanted timeslot the request arrived in
+	 * @return timeslot, std::nullopt if not free
+	 */
+	std::optional<uint32_t> allocate(uint32_t wanted);
+
+	/**
+	 * @brief free granted slots whose car never checked in
+	 */
+	void reclaim();
+
+	/**
+	 * @brief announce the free slots, lock must be held
+	 */
+	void publish();
+
+	/**
+	 * @brief answers slot requests until inactive
+	 */
+	void worker_loop();
+
+	// NOLINTNEXTLINE
+	beacon &downlink;
+	// NOLINTNEXTLINE
+	std::atomic<bool> &active_flag;
+	std::shared_ptr<slot_mux> mux;
+	uint32_t slot_count;
+	std::chrono::microseconds slot_duration;
+	std::chrono::nanoseconds grant_timeout;
+	// Answers requests sent in open slots
+	std::array<std::unique_ptr<tdma>, slot_mux::MAX_SLOTS> answers;
+	// Guards slots
+	std::mutex lock;
+	std::array<allocation, slot_mux::MAX_SLOTS> slots = {};
+	std::atomic<uint64_t> granted = 0;
+	std::atomic<uint64_t> refused = 0;
+	std::unique_ptr<std::thread> thread;
+};
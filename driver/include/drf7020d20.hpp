@@ -4,16 +4,21 @@
  */
 #pragma once
 
-#include <atomic>
 #include <chrono>
 #include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
 #include <thread>
 
 #include <gpiod.hpp>
 
+#include "transport.hpp"
 #include "uart.hpp"
 
-class drf7020d20 {
+class drf7020d20 : public rf_transport {
 public:
 	enum rate {
 		DR1200 = 0,
@@ -46,7 +51,22 @@ public:
 		uint32_t set_pin,
 		uint32_t uart_port);
 
-	~drf7020d20();
+	/**
+	 * @brief Constructor.
+	 *
+	 * @param[in] chip - libgpiod GPIO chip object.
+	 * @param[in] en_pin - EN libgpiod pin number.
+	 * @param[in] aux_pin - AUX libgpiod pin number.
+	 * @param[in] set_pin - SET libgpiod pin number.
+	 * @param[in] uart_path - Path to the serial device to use.
+	 */
+	drf7020d20(const gpiod::chip &chip,
+		uint32_t en_pin,
+		uint32_t aux_pin,
+		uint32_t set_pin,
+		const std::string &uart_path);
+
+	~drf7020d20() override;
 
 	/**
 	 * @brief Enable module.
@@ -60,19 +80,22 @@ public:
 	void disable();
 
 	/**
-	 * @brief Enable message rejecter.
-	 *
+	 * @brief Start the receive reactor.
+	 * @note Received messages are only kept while a receiver is waiting or a
+	 * callback is set; everything else is discarded.
 	 */
-	void rejecter_on();
+	void reactor_on() override;
 
 	/**
-	 * @brief Enable message rejecter.
+	 * @brief Stop the receive reactor.
 	 *
 	 */
-	void rejecter_off();
+	void reactor_off() override;
 
 	/**
 	 * @brief Configure RF module.
+	 * @note Returns as soon as the module answers. Parameters this driver
+	 * already applied are not sent again. The reactor must be off.
 	 *
 	 * @param[in] freq - Channel frequency in kHz.
 	 * @note Range: 418000-455000 kHz.
@@ -90,32 +113,87 @@ public:
 		parity parity) const;
 
 	/**
-	 * @brief Transmit message over radio.
+	 * @brief Get the bitrate of a rate setting.
+	 *
+	 * @param[in] value - Rate setting.
+	 * @return Bitrate in bps.
+	 */
+	static uint32_t rate_bps(rate value);
+
+	/**
+	 * @brief Get the airtime of one frame at the configured FSK rate.
+	 * @note Assumes the module default of 9600 bps before configure().
 	 *
-	 * @param[in] msg - Message to send.
-	 * @return Boolean result.
 	 */
-	bool transmit(const std::string &msg) const;
+	std::chrono::nanoseconds get_frame_airtime() const override;
+
+	using rf_transport::receive;
+	using rf_transport::transmit;
 
 	/**
 	 * @brief Transmit message over radio.
+	 * @note The last frame is padded with NUL bytes.
 	 *
 	 * @param[in] msg - Message to send.
 	 * @param[in] length - Message length.
 	 * @return Boolean result.
 	 */
-	bool transmit(const char *msg, uint32_t length) const;
+	bool transmit(const char *msg, uint32_t length) const override;
 
 	/**
-	 * @brief Receive message over radio.
+	 * @brief Receive message over radio without allocating.
 	 * @note Blocks until a message is received or timeout.
 	 *
+	 * @param[out] msg - Received message.
 	 * @param[in] timeout - Wait timeout.
-	 * @return Received message. Empty string on timeout.
+	 * @return True if a message was received.
 	 */
-	std::string receive(std::chrono::milliseconds timeout) const;
+	bool receive(frame &msg, std::chrono::milliseconds timeout) const override;
 
 private:
+	/**
+	 * @brief Module parameters applied by configure().
+	 */
+	struct module_config {
+		uint32_t freq;
+		rate fsk_rate;
+		uint32_t power_level;
+		rate uart_rate;
+		parity uart_parity;
+
+		bool operator==(const module_config &other) const = default;
+	};
+
+	/**
+	 * @brief Read a configuration reply.
+	 *
+	 * @param[out] buffer - NUL terminated reply, including CRLF.
+	 * @param[in] max_length - Buffer size.
+	 * @param[in] timeout - Time allowed for the whole reply.
+	 * @return True if a complete line was read in time.
+	 */
+	bool read_reply(char *buffer,
+		uint32_t max_length,
+		std::chrono::milliseconds timeout) const;
+
+	/**
+	 * @brief Reactor thread body.
+	 *
+	 */
+	void reactor_loop();
+
+	/**
+	 * @brief Note the start of a frame on an AUX edge.
+	 *
+	 */
+	void on_aux_edge();
+
+	/**
+	 * @brief Read serial data and pass on every completed frame.
+	 *
+	 */
+	void on_serial_data();
+
 	uart serial;
 	gpiod::line en;
 	gpiod::line aux;
@@ -123,7 +201,16 @@ private:
 
 	bool enable_flag = false;
 
-	std::unique_ptr<std::thread> rejecter_thread = nullptr;
-	std::atomic<bool> rejecter = false;
-	mutable std::atomic<bool> rejecter_standby = false;
+	// Guards applied_config
+	mutable std::mutex config_lock;
+	mutable std::optional<module_config> applied_config;
+
+	std::unique_ptr<std::thread> reactor_thread = nullptr;
+	int epoll_fd = -1;
+	int stop_fd = -1;
+	// Frame reassembly, reactor thread only
+	timestamp frame_start;
+	timestamp next_frame_start;
+	timestamp last_data;
+	bool next_frame_edge = false;
 };
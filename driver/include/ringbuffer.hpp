@@ -0,0 +1,101 @@
+/**
+ * @file include/ringbuffer.hpp
+ * @brief Preallocated byte ring buffer with contiguous views.
+ */
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <span>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+/**
+ * @brief Byte ring buffer filled straight from a file descriptor.
+ * @note Every byte is also stored in a mirror copy directly after the main
+ * storage, so any run of buffered bytes can be viewed without copying.
+ *
+ * @tparam CAPACITY Buffer size in bytes.
+ */
+template<size_t CAPACITY>
+class ring_buffer {
+public:
+	/**
+	 * @brief Read whatever is available from a file descriptor.
+	 *
+	 * @param[in] fd - File descriptor to read from.
+	 * @return Bytes read, negative on error. Zero if the buffer is full.
+	 */
+	ssize_t fill(int fd) {
+		size_t space = CAPACITY - count;
+		if (space == 0) {
+			return 0;
+		}
+
+		size_t tail = (head + count) % CAPACITY;
+		size_t first = std::min(space, CAPACITY - tail);
+
+		std::array<iovec, 2> parts = {{
+			{.iov_base = &storage[tail], .iov_len = first},
+			{.iov_base = &storage[0], .iov_len = space - first},
+		}};
+		ssize_t bytes = readv(fd, parts.data(), parts[1].iov_len > 0 ? 2 : 1);
+		if (bytes <= 0) {
+			return bytes;
+		}
+
+		// Update mirror
+		auto written = (size_t)bytes;
+		size_t wrapped = written > first ? written - first : 0;
+		std::memcpy(&storage[tail + CAPACITY], &storage[tail], written - wrapped);
+		std::memcpy(&storage[CAPACITY], &storage[0], wrapped);
+
+		count += written;
+		return bytes;
+	}
+
+	/**
+	 * @brief View buffered bytes without removing them.
+	 *
+	 * @param[in] length - Bytes to view, clamped to the buffered amount.
+	 * @return View valid until the next consume() or fill().
+	 */
+	std::span<const std::byte> peek(size_t length) const {
+		return {&storage[head], std::min(length, count)};
+	}
+
+	/**
+	 * @brief Drop bytes from the front of the buffer.
+	 *
+	 * @param[in] length - Bytes to drop, clamped to the buffered amount.
+	 */
+	void consume(size_t length) {
+		length = std::min(length, count);
+		head = (head + length) % CAPACITY;
+		count -= length;
+	}
+
+	/**
+	 * @brief Drop all buffered bytes.
+	 *
+	 */
+	inline void clear() {
+		head = 0;
+		count = 0;
+	}
+
+	/**
+	 * @brief Get amount of buffered bytes.
+	 *
+	 */
+	inline size_t size() const {
+		return count;
+	}
+
+private:
+	std::array<std::byte, CAPACITY * 2> storage = {};
+	size_t head = 0;
+	size_t count = 0;
+};
@@ -0,0 +1,183 @@
+/**
+ * @file include/transport.hpp
+ * @brief Radio transport interface.
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+
+class rf_transport {
+public:
+	/** Messages are sent and received in frames of exactly this size. */
+	static constexpr size_t FRAME_SIZE = 15;
+
+	/** CLOCK_MONOTONIC time point. */
+	using timestamp = std::chrono::steady_clock::time_point;
+
+	struct frame {
+		std::array<char, FRAME_SIZE> data;
+		uint8_t length;
+		timestamp arrival;
+
+		/**
+		 * @brief View message contents.
+		 * @note NUL padding at the end is not included.
+		 *
+		 */
+		inline std::string_view view() const {
+			return {data.data(), strnlen(data.data(), length)};
+		}
+
+		/**
+		 * @brief View raw frame contents, for binary messages.
+		 *
+		 */
+		inline std::span<const uint8_t> bytes() const {
+			return {reinterpret_cast<const uint8_t *>(data.data()), length};
+		}
+	};
+
+	virtual ~rf_transport() = default;
+
+	/**
+	 * @brief Time one frame takes over the air.
+	 * @note Counts 8 bits per byte.
+	 *
+	 * @param[in] bitrate - Over the air bitrate in bps.
+	 * @return Frame airtime.
+	 */
+	static constexpr std::chrono::nanoseconds frame_airtime(uint32_t bitrate) {
+		return std::chrono::nanoseconds(
+			FRAME_SIZE * 8 * uint64_t(1000000000) / bitrate);
+	}
+
+	/**
+	 * @brief Get the airtime of one frame at the current data rate.
+	 *
+	 */
+	virtual std::chrono::nanoseconds get_frame_airtime() const = 0;
+
+	/**
+	 * @brief Start receiving frames in the background.
+	 * @note Received frames are only kept while a receiver is waiting or a
+	 * callback is set; everything else is discarded.
+	 */
+	virtual void reactor_on() = 0;
+
+	/**
+	 * @brief Stop receiving frames in the background.
+	 *
+	 */
+	virtual void reactor_off() = 0;
+
+	/**
+	 * @brief Deliver received frames to a callback instead of receive().
+	 * @note The callback runs on the receiving thread and gets the frame
+	 * contents and its arrival time.
+	 * @note Blocks until a running callback returns, so the callback must not
+	 * call back into the transport.
+	 *
+	 * @param[in] callback - Frame handler, nullptr to unset.
+	 */
+	void set_receive_callback(
+		std::function<void(std::string_view, timestamp)> callback);
+
+	/**
+	 * @brief Drop frames failing a check before any consumer sees them.
+	 * @note Runs on the receiving thread, so it should be quick. The check
+	 * may repair the frame in place.
+	 *
+	 * @param[in] check - Returns false for corrupt frames, nullptr to accept
+	 * everything.
+	 */
+	void set_frame_check(std::function<bool(std::span<uint8_t>)> check);
+
+	/**
+	 * @brief Get count of frames dropped by the frame check.
+	 *
+	 */
+	inline uint64_t get_rejected() const {
+		return rejected;
+	}
+
+	/**
+	 * @brief Get count of frames repaired by the frame check.
+	 *
+	 */
+	inline uint64_t get_repaired() const {
+		return repaired;
+	}
+
+	/**
+	 * @brief Transmit message.
+	 * @note The last frame is padded with NUL bytes.
+	 *
+	 * @param[in] msg - Message to send.
+	 * @return Boolean result.
+	 */
+	bool transmit(const std::string &msg) const;
+
+	/**
+	 * @brief Transmit message.
+	 * @note The last frame is padded with NUL bytes.
+	 *
+	 * @param[in] msg - Message to send.
+	 * @param[in] length - Message length.
+	 * @return Boolean result.
+	 */
+	virtual bool transmit(const char *msg, uint32_t length) const = 0;
+
+	/**
+	 * @brief Receive message.
+	 * @note Blocks until a message is received or timeout.
+	 *
+	 * @param[in] timeout - Wait timeout.
+	 * @return Received message. Empty string on timeout.
+	 */
+	std::string receive(std::chrono::milliseconds timeout) const;
+
+	/**
+	 * @brief Receive message without allocating.
+	 * @note Blocks until a message is received or timeout.
+	 *
+	 * @param[out] msg - Received message.
+	 * @param[in] timeout - Wait timeout.
+	 * @return True if a message was received.
+	 */
+	virtual bool receive(frame &msg, std::chrono::milliseconds timeout) const;
+
+protected:
+	/**
+	 * @brief Hand a received frame to the consumers.
+	 *
+	 * @param[in] msg - Frame contents, at most FRAME_SIZE bytes.
+	 * @param[in] arrival - Frame arrival time.
+	 */
+	void deliver(std::string_view msg, timestamp arrival);
+
+private:
+	static constexpr size_t RX_QUEUE_SIZE = 8;
+
+	std::function<void(std::string_view, timestamp)> receive_callback =
+		nullptr;
+	std::function<bool(std::span<uint8_t>)> frame_check = nullptr;
+	std::atomic<uint64_t> rejected = 0;
+	std::atomic<uint64_t> repaired = 0;
+
+	mutable std::mutex rx_lock;
+	mutable std::condition_variable rx_cond;
+	mutable std::array<frame, RX_QUEUE_SIZE> rx_queue = {};
+	mutable size_t rx_head = 0;
+	mutable size_t rx_count = 0;
+	mutable uint32_t rx_waiting = 0;
+};
@@ -4,10 +4,14 @@
  */
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
+#include <span>
 #include <string>
 #include <termios.h>
 
+#include "ringbuffer.hpp"
+
 class uart {
 public:
 	/**
@@ -17,8 +21,23 @@ public:
 	 */
 	uart(uint32_t port);
 
+	/**
+	 * @brief Constructor.
+	 *
+	 * @param[in] path - Path to the serial device.
+	 */
+	uart(const std::string &path);
+
 	~uart();
 
+	/**
+	 * @brief Get device path of a numbered serial port.
+	 *
+	 * @param[in] port - UART port as defined by the OS.
+	 * @return Device path.
+	 */
+	static std::string port_path(uint32_t port);
+
 	/**
 	 * @brief Write to serial.
 	 *
@@ -52,7 +71,55 @@ public:
 	 */
 	ssize_t read(char *buffer, uint32_t max_length) const;
 
+	/**
+	 * @brief Read available serial data into the receive buffer.
+	 *
+	 * @return Bytes read, negative on error.
+	 */
+	inline ssize_t fill() {
+		return rx_buffer.fill(fd);
+	}
+
+	/**
+	 * @brief View buffered received data without copying.
+	 *
+	 * @param[in] length - Maximum bytes to view.
+	 * @return View valid until the next consume() or fill().
+	 */
+	inline std::span<const std::byte> peek(size_t length) const {
+		return rx_buffer.peek(length);
+	}
+
+	/**
+	 * @brief Drop data from the receive buffer.
+	 *
+	 * @param[in] length - Bytes to drop.
+	 */
+	inline void consume(size_t length) {
+		rx_buffer.consume(length);
+	}
+
+	/**
+	 * @brief Get amount of buffered received data.
+	 *
+	 */
+	inline size_t buffered() const {
+		return rx_buffer.size();
+	}
+
+	/**
+	 * @brief Get the underlying file descriptor for polling.
+	 *
+	 * @return Serial file descriptor.
+	 */
+	inline int get_fd() const {
+		return fd;
+	}
+
 private:
+	static constexpr size_t RX_BUFFER_SIZE = 256;
+
 	int fd;
 	struct termios old_settings;
+	ring_buffer<RX_BUFFER_SIZE> rx_buffer;
 };
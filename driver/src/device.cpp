@@ -1,5 +1,22 @@
 #include "device.hpp"
 
+#include <system_error>
+
 #include <gpiod.hpp>
 
-const gpiod::chip gpio_pins(gpiochip0);
+/**
+ * @brief Open the GPIO chip if the system has one.
+ * @note Without it, hardware drivers fail once used, but programs still start
+ * for hardware-free use such as simulation.
+ *
+ * @return GPIO chip object.
+ */
+static gpiod::chip open_chip() {
+	try {
+		return gpiod::chip(gpiochip0);
+	} catch (std::system_error &) {
+		return {};
+	}
+}
+
+const gpiod::chip gpio_pins = open_chip();
@@ -4,14 +4,22 @@
  */
 #include "drf7020d20.hpp"
 
+#include <array>
+#include <cerrno>
 #include <chrono>
 #include <cstdint>
 #include <cstdio>
 #include <cstring>
 #include <fcntl.h>
 #include <memory>
+#include <mutex>
+#include <poll.h>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <termios.h>
 #include <thread>
 #include <unistd.h>
 
@@ -19,12 +27,46 @@
 
 #include "defines.hpp"
 
+static constexpr int MAX_EVENTS = 3;
+
+// Time allowed for a whole frame to arrive over the serial port
+static constexpr auto FRAME_TIMEOUT = std::chrono::milliseconds(30);
+// Silence after which a partial frame is considered broken
+static constexpr auto FRAME_GAP = std::chrono::milliseconds(5);
+// Mode switch settling time on SET changes
+static constexpr auto SET_SETTLE = std::chrono::milliseconds(1);
+// Longest wait for the module to answer a configuration command
+static constexpr auto CONFIG_TIMEOUT = std::chrono::milliseconds(250);
+
+// Bitrate of each rate setting
+static constexpr uint32_t RATE_BPS[] = {
+	1200, 2400, 4800, 9600, 19200, 38400, 57600};
+
+/**
+ * @brief Convert a libgpiod event timestamp into a time point.
+ *
+ * @param[in] event - GPIO line event.
+ * @return Monotonic time point.
+ */
+static drf7020d20::timestamp event_time(const gpiod::line_event &event) {
+	return drf7020d20::timestamp(
+		std::chrono::duration_cast<drf7020d20::timestamp::duration>(
+			event.timestamp));
+}
+
 drf7020d20::drf7020d20(const gpiod::chip &chip,
 	uint32_t en_pin,
 	uint32_t aux_pin,
 	uint32_t set_pin,
 	uint32_t uart_port)
-	: serial(uart_port),
+	: drf7020d20(chip, en_pin, aux_pin, set_pin, uart::port_path(uart_port)) {}
+
+drf7020d20::drf7020d20(const gpiod::chip &chip,
+	uint32_t en_pin,
+	uint32_t aux_pin,
+	uint32_t set_pin,
+	const std::string &uart_path)
+	: serial(uart_path),
 	  en(chip.get_line(en_pin)),
 	  aux(chip.get_line(aux_pin)),
 	  set(chip.get_line(set_pin)) {
@@ -49,8 +91,8 @@ drf7020d20::drf7020d20(const gpiod::chip &chip,
 }
 
 drf7020d20::~drf7020d20() {
-	if (rejecter) {
-		rejecter_off();
+	if (reactor_thread != nullptr) {
+		reactor_off();
 	}
 
 	en.release();
@@ -70,33 +112,52 @@ void drf7020d20::disable() {
 	enable_flag = false;
 }
 
-void drf7020d20::rejecter_on() {
-	if (rejecter_thread != nullptr) {
+void drf7020d20::reactor_on() {
+	if (reactor_thread != nullptr) {
 		return;
 	}
 
-	auto executor = [&]() {
-		while (rejecter) {
-			while (rejecter_standby) {
-				std::this_thread::sleep_for(std::chrono::milliseconds(1));
-			}
+	if ((epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+		throw std::runtime_error("Failed to create epoll instance");
+	}
+	if ((stop_fd = eventfd(0, EFD_CLOEXEC)) < 0) {
+		close(epoll_fd);
+		throw std::runtime_error("Failed to create reactor stop event");
+	}
 
-			if (aux.event_wait(std::chrono::milliseconds(1))) {
-				// Clear events and data buffer
-				aux.event_read();
-				serial.read();
-			}
+	// Wait on AUX edges, incoming data and the stop signal together
+	int fds[] = {aux.event_get_fd(), serial.get_fd(), stop_fd};
+	for (int watch_fd : fds) {
+		epoll_event event = {
+			.events = EPOLLIN | EPOLLPRI,
+			.data = {.fd = watch_fd},
+		};
+		if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, watch_fd, &event) < 0) {
+			close(stop_fd);
+			close(epoll_fd);
+			throw std::runtime_error("Failed to register reactor events");
 		}
-	};
+	}
 
-	rejecter = true;
-	rejecter_thread = std::make_unique<std::thread>(executor);
+	reactor_thread = std::make_unique<std::thread>([this]() {
+		reactor_loop();
+	});
 }
 
-void drf7020d20::rejecter_off() {
-	rejecter = false;
-	rejecter_thread->join();
-	rejecter_thread.reset();
+void drf7020d20::reactor_off() {
+	if (reactor_thread == nullptr) {
+		return;
+	}
+
+	uint64_t signal = 1;
+	::write(stop_fd, &signal, sizeof(signal));
+	reactor_thread->join();
+	reactor_thread.reset();
+
+	close(stop_fd);
+	close(epoll_fd);
+	stop_fd = -1;
+	epoll_fd = -1;
 }
 
 bool drf7020d20::configure(uint32_t freq,
@@ -115,43 +176,68 @@ bool drf7020d20::configure(uint32_t freq,
 		return false;
 	}
 
+	if (reactor_thread != nullptr) {
+		throw std::logic_error("Reactor is running, cannot configure");
+	}
+
+	// Skip if the module already runs with these parameters
+	module_config config = {
+		.freq = freq,
+		.fsk_rate = fsk_rate,
+		.power_level = power_level,
+		.uart_rate = uart_rate,
+		.uart_parity = parity,
+	};
+	{
+		// Not held over the serial exchange
+		std::lock_guard<std::mutex> guard(config_lock);
+		if (applied_config == config) {
+			return true;
+		}
+		applied_config.reset();
+	}
+
 	// Enable set mode
 	set.set_value(0);
-	std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	std::this_thread::sleep_for(SET_SETTLE);
 
-	// Send command
-	char buf[22];
-	std::snprintf(buf, 22, "WR %u %u %u %u %u\r\n", freq, fsk_rate, power_level,
+	// Send command, dropping stale input first
+	char buf[32];
+	std::snprintf(buf, 32, "WR %u %u %u %u %u\r\n", freq, fsk_rate, power_level,
 		uart_rate, parity);
-	serial.write(buf, std::strlen(buf));
-
-	// Expected response
-	char expect[22];
-	std::snprintf(expect, 22, "PARA %u %u %u %u %u\r\n", freq, fsk_rate,
-		power_level, uart_rate, parity);
-
-	// Get response
-	std::this_thread::sleep_for(std::chrono::milliseconds(200));
-	if (serial.read(buf, 21) < 0) {
-		return false;
-	}
+	tcflush(serial.get_fd(), TCIFLUSH);
+	bool verify = serial.write(buf, std::strlen(buf)) &&
+				  read_reply(buf, sizeof(buf), CONFIG_TIMEOUT);
 
 	// Verify response
-	bool verify = std::strncmp(buf, expect, 21) == 0;
+	if (verify) {
+		char expect[32];
+		std::snprintf(expect, 32, "PARA %u %u %u %u %u\r\n", freq, fsk_rate,
+			power_level, uart_rate, parity);
+		verify = std::strcmp(buf, expect) == 0;
+	}
 
 	// Reset
 	set.set_value(1);
-	std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	std::this_thread::sleep_for(SET_SETTLE);
+
+	if (verify) {
+		std::lock_guard<std::mutex> guard(config_lock);
+		applied_config = config;
+	}
 
 	return verify;
 }
 
-bool drf7020d20::transmit(const std::string &msg) const {
-	if (!enable_flag) {
-		throw std::logic_error("Radio is disabled, cannot transmit");
-	}
+uint32_t drf7020d20::rate_bps(rate value) {
+	return RATE_BPS[value];
+}
 
-	return serial.write(msg);
+std::chrono::nanoseconds drf7020d20::get_frame_airtime() const {
+	std::lock_guard<std::mutex> guard(config_lock);
+	rate fsk_rate =
+		applied_config.has_value() ? applied_config->fsk_rate : DR9600;
+	return frame_airtime(rate_bps(fsk_rate));
 }
 
 bool drf7020d20::transmit(const char *msg, uint32_t length) const {
@@ -159,23 +245,170 @@ bool drf7020d20::transmit(const char *msg, uint32_t length) const {
 		throw std::logic_error("Radio is disabled, cannot transmit");
 	}
 
-	return serial.write(msg, length);
+	uint32_t partial = length % FRAME_SIZE;
+	uint32_t full = length - partial;
+	if (full > 0 && !serial.write(msg, full)) {
+		return false;
+	}
+	if (partial == 0) {
+		return true;
+	}
+
+	// Pad last frame
+	std::array<char, FRAME_SIZE> last = {};
+	std::memcpy(last.data(), msg + full, partial);
+	return serial.write(last.data(), last.size());
 }
 
-std::string drf7020d20::receive(std::chrono::milliseconds timeout) const {
+bool drf7020d20::receive(frame &msg, std::chrono::milliseconds timeout) const {
 	if (!enable_flag) {
 		throw std::logic_error("Radio is disabled, cannot receive");
 	}
 
-	rejecter_standby = true;
-	bool received = aux.event_wait(timeout);
-	rejecter_standby = false;
+	// Without the reactor, read directly
+	if (reactor_thread == nullptr) {
+		if (!aux.event_wait(timeout)) {
+			return false;
+		}
+
+		// Clear event & read whole frame
+		msg.arrival = event_time(aux.event_read());
+		msg.length = 0;
+
+		auto deadline = std::chrono::steady_clock::now() + FRAME_TIMEOUT;
+		pollfd serial_poll = {
+			.fd = serial.get_fd(),
+			.events = POLLIN,
+			.revents = 0,
+		};
+		while (msg.length < FRAME_SIZE) {
+			auto remaining =
+				std::chrono::duration_cast<std::chrono::milliseconds>(
+					deadline - std::chrono::steady_clock::now());
+			if (remaining.count() <= 0 ||
+				poll(&serial_poll, 1, (int)remaining.count()) <= 0) {
+				return false;
+			}
+
+			ssize_t length = serial.read(
+				msg.data.data() + msg.length, FRAME_SIZE - msg.length);
+			if (length <= 0) {
+				return false;
+			}
+			msg.length += length;
+		}
 
-	if (!received) {
-		return "";
+		return true;
 	}
 
-	// Clear event & read data
-	aux.event_read();
-	return serial.read();
+	return rf_transport::receive(msg, timeout);
+}
+
+bool drf7020d20::read_reply(char *buffer,
+	uint32_t max_length,
+	std::chrono::milliseconds timeout) const {
+	auto deadline = std::chrono::steady_clock::now() + timeout;
+	pollfd serial_poll = {
+		.fd = serial.get_fd(),
+		.events = POLLIN,
+		.revents = 0,
+	};
+
+	// Read until CRLF, leaving room for the terminator
+	uint32_t length = 0;
+	while (length < max_length - 1) {
+		auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+			deadline - std::chrono::steady_clock::now());
+		if (remaining.count() <= 0 ||
+			poll(&serial_poll, 1, (int)remaining.count()) <= 0) {
+			return false;
+		}
+
+		ssize_t count = serial.read(buffer + length, max_length - 1 - length);
+		if (count <= 0) {
+			return false;
+		}
+		length += count;
+		buffer[length] = '\0';
+
+		if (length >= 2 && std::strcmp(buffer + length - 2, "\r\n") == 0) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void drf7020d20::reactor_loop() {
+	epoll_event events[MAX_EVENTS];
+
+	while (true) {
+		int count = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+		if (count < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return;
+		}
+
+		bool edge = false;
+		bool data = false;
+		for (int i = 0; i < count; i++) {
+			int ready_fd = events[i].data.fd;
+			if (ready_fd == stop_fd) {
+				return;
+			}
+
+			edge = edge || ready_fd == aux.event_get_fd();
+			data = data || ready_fd == serial.get_fd();
+		}
+
+		// Edge marks the frame start, so handle it before the data
+		if (edge) {
+			on_aux_edge();
+		}
+		if (data) {
+			on_serial_data();
+		}
+	}
+}
+
+void drf7020d20::on_aux_edge() {
+	timestamp edge_time = std::chrono::steady_clock::now();
+	for (const auto &event : aux.event_read_multiple()) {
+		edge_time = event_time(event);
+	}
+
+	// Leftovers of an interrupted frame
+	if (serial.buffered() > 0 && edge_time - last_data > FRAME_GAP) {
+		serial.consume(serial.buffered());
+		next_frame_edge = false;
+	}
+
+	if (serial.buffered() == 0) {
+		frame_start = edge_time;
+	} else {
+		// Previous frame is still arriving
+		next_frame_start = edge_time;
+		next_frame_edge = true;
+	}
+}
+
+void drf7020d20::on_serial_data() {
+	if (serial.fill() <= 0) {
+		return;
+	}
+	last_data = std::chrono::steady_clock::now();
+
+	// Hand out completed frames in place
+	while (serial.buffered() >= FRAME_SIZE) {
+		auto data = serial.peek(FRAME_SIZE);
+		const auto *bytes = reinterpret_cast<const char *>(data.data());
+		deliver({bytes, data.size()}, frame_start);
+		serial.consume(data.size());
+
+		// Back-to-back frames without an edge of their own
+		frame_start = next_frame_edge ? next_frame_start : last_data;
+		next_frame_edge = false;
+	}
 }
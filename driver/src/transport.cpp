@@ -0,0 +1,108 @@
+/**
+ * @file src/transport.cpp
+ * @brief Radio transport interface.
+ */
+#include "transport.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+
+void rf_transport::set_receive_callback(
+	std::function<void(std::string_view, timestamp)> callback) {
+	std::lock_guard<std::mutex> guard(rx_lock);
+	receive_callback = std::move(callback);
+}
+
+void rf_transport::set_frame_check(
+	std::function<bool(std::span<uint8_t>)> check) {
+	std::lock_guard<std::mutex> guard(rx_lock);
+	frame_check = std::move(check);
+}
+
+bool rf_transport::transmit(const std::string &msg) const {
+	return transmit(msg.data(), msg.length());
+}
+
+std::string rf_transport::receive(std::chrono::milliseconds timeout) const {
+	frame msg;
+	if (!receive(msg, timeout)) {
+		return "";
+	}
+
+	return std::string(msg.view());
+}
+
+bool rf_transport::receive(
+	frame &msg, std::chrono::milliseconds timeout) const {
+	std::unique_lock<std::mutex> guard(rx_lock);
+	rx_waiting++;
+	bool received = rx_cond.wait_for(guard, timeout, [this]() {
+		return rx_count > 0;
+	});
+	rx_waiting--;
+
+	if (!received) {
+		return false;
+	}
+
+	msg = rx_queue[rx_head];
+	rx_head = (rx_head + 1) % RX_QUEUE_SIZE;
+	rx_count--;
+
+	// Nobody is left to take the rest
+	if (rx_waiting == 0) {
+		rx_count = 0;
+	}
+
+	return true;
+}
+
+void rf_transport::deliver(std::string_view msg, timestamp arrival) {
+	std::lock_guard<std::mutex> guard(rx_lock);
+
+	// Nobody wakes up for a corrupt frame
+	std::array<char, FRAME_SIZE> checked;
+	if (frame_check != nullptr) {
+		size_t length = std::min(msg.size(), FRAME_SIZE);
+		std::memcpy(checked.data(), msg.data(), length);
+		if (!frame_check(
+				{reinterpret_cast<uint8_t *>(checked.data()), length})) {
+			rejected++;
+			return;
+		}
+
+		if (std::memcmp(checked.data(), msg.data(), length) != 0) {
+			repaired++;
+		}
+		msg = {checked.data(), length};
+	}
+
+	if (receive_callback != nullptr) {
+		receive_callback(msg, arrival);
+		return;
+	}
+
+	// Reject messages nobody is waiting for
+	if (rx_waiting == 0) {
+		return;
+	}
+
+	// Overwrite the oldest message if full
+	if (rx_count == RX_QUEUE_SIZE) {
+		rx_head = (rx_head + 1) % RX_QUEUE_SIZE;
+		rx_count--;
+	}
+
+	frame &slot = rx_queue[(rx_head + rx_count) % RX_QUEUE_SIZE];
+	std::memcpy(slot.data.data(), msg.data(), msg.size());
+	slot.length = (uint8_t)msg.size();
+	slot.arrival = arrival;
+	rx_count++;
+	rx_cond.notify_one();
+}
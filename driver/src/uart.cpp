@@ -12,12 +12,19 @@
 #include <termios.h>
 #include <unistd.h>
 
-// termios struct is initialized with tcgetattr
-// NOLINTNEXTLINE(cppcoreguidelines-pro-type-member-init)
-uart::uart(uint32_t port) {
+uart::uart(uint32_t port)
+	: uart(port_path(port)) {}
+
+std::string uart::port_path(uint32_t port) {
 	char serial[32];
 	std::snprintf(serial, 32, "/dev/serial%u", port);
-	if ((fd = open(serial, O_RDWR)) < 0) {
+	return serial;
+}
+
+// termios struct is initialized with tcgetattr
+// NOLINTNEXTLINE(cppcoreguidelines-pro-type-member-init)
+uart::uart(const std::string &path) {
+	if ((fd = open(path.c_str(), O_RDWR)) < 0) {
 		throw std::runtime_error("Failed to open serial port");
 	}
 
@@ -49,11 +56,12 @@ bool uart::write(const char *data, uint32_t length) const {
 
 std::string uart::read() const {
 	char buffer[256];
-	if (::read(fd, buffer, 256) < 0) {
+	ssize_t length = ::read(fd, buffer, 256);
+	if (length < 0) {
 		return "";
 	}
 
-	return std::string(buffer);
+	return std::string(buffer, length);
 }
 
 ssize_t uart::read(char *buffer, uint32_t max_length) const {
@@ -0,0 +1,33 @@
+#!/bin/sh
+# Create a gpio-sim chip for the emulator.
+# Requires root and the gpio-sim kernel module.
+# Lines: 0 - EN, 1 - AUX, 2 - SET
+set -e
+
+NAME=air-emu
+CONFIG=/sys/kernel/config/gpio-sim/$NAME
+
+if [ "$1" = "remove" ]; then
+	echo 0 > $CONFIG/live
+	rmdir $CONFIG/bank0
+	rmdir $CONFIG
+	exit 0
+fi
+
+modprobe gpio-sim
+mkdir -p $CONFIG/bank0
+echo 3 > $CONFIG/bank0/num_lines
+echo 1 > $CONFIG/live
+
+DEV=$(cat $CONFIG/dev_name)
+CHIP=$(cat $CONFIG/bank0/chip_name)
+SYSFS=/sys/devices/platform/$DEV/$CHIP
+
+# AUX idles high
+echo pull-up > $SYSFS/sim_gpio1/pull
+
+# Let the invoking user run the emulator and bench
+chmod a+rw /dev/$CHIP $SYSFS/sim_gpio*/pull
+
+echo "GPIO chip: $CHIP"
+echo "Emulator sysfs: $SYSFS"
@@ -0,0 +1,134 @@
+/**
+ * @file src/bench.cpp
+ * @brief Driver latency measurements against the module emulator.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <string>
+
+#include <gpiod.hpp>
+
+#include "drf7020d20.hpp"
+
+using bench_clock = std::chrono::steady_clock;
+
+// Must match the emulator
+static constexpr uint32_t EN_LINE = 0;
+static constexpr uint32_t AUX_LINE = 1;
+static constexpr uint32_t SET_LINE = 2;
+
+static constexpr uint32_t FREQ_A = 433900;
+static constexpr uint32_t FREQ_B = 434900;
+
+class latency_stats {
+public:
+	/**
+	 * @brief Add a measurement.
+	 *
+	 * @param[in] sample - Measured duration.
+	 */
+	inline void add(bench_clock::duration sample) {
+		long long micros =
+			std::chrono::duration_cast<std::chrono::microseconds>(sample)
+				.count();
+		min = std::min(min, micros);
+		max = std::max(max, micros);
+		total += micros;
+		count++;
+	}
+
+	/**
+	 * @brief Print summary line.
+	 *
+	 * @param[in] name - Measurement name.
+	 */
+	void print(const std::string &name) const {
+		if (count == 0) {
+			printf("%-20s no samples\n", name.c_str());
+			return;
+		}
+
+		printf("%-20s n=%-5lld min=%-8lld avg=%-8lld max=%-8lld us\n",
+			name.c_str(), count, min, total / count, max);
+	}
+
+private:
+	long long min = std::numeric_limits<long long>::max();
+	long long max = 0;
+	long long total = 0;
+	long long count = 0;
+};
+
+int main(int argc, char **argv) {
+	if (argc < 3) {
+		std::cerr << "Usage: " << argv[0]
+				  << " <serial link> <gpio chip> [iterations]\n";
+		return 1;
+	}
+
+	uint32_t iterations = argc > 3 ? std::atoi(argv[3]) : 100;
+
+	gpiod::chip chip(argv[2]);
+	drf7020d20 radio(chip, EN_LINE, AUX_LINE, SET_LINE, std::string(argv[1]));
+	radio.enable();
+
+	// Alternate channels so every call reconfigures
+	latency_stats configure_stats;
+	for (uint32_t i = 0; i < iterations; i++) {
+		auto start = bench_clock::now();
+		bool result = radio.configure(i % 2 == 0 ? FREQ_A : FREQ_B,
+			drf7020d20::DR9600, 9, drf7020d20::DR9600, drf7020d20::NONE);
+		configure_stats.add(bench_clock::now() - start);
+
+		if (!result) {
+			std::cerr << "Configuration failed\n";
+			return 1;
+		}
+	}
+
+	// Same parameters again only hit the cache
+	latency_stats cached_stats;
+	for (uint32_t i = 0; i < iterations; i++) {
+		auto start = bench_clock::now();
+		radio.configure(
+			FREQ_B, drf7020d20::DR9600, 9, drf7020d20::DR9600, drf7020d20::NONE);
+		cached_stats.add(bench_clock::now() - start);
+	}
+
+	radio.reactor_on();
+
+	latency_stats tx_stats;
+	latency_stats turnaround_stats;
+	latency_stats wakeup_stats;
+	rf_transport::frame msg;
+	for (uint32_t i = 0; i < iterations; i++) {
+		// Whole frame goes out, zero padded after the text
+		char payload[rf_transport::FRAME_SIZE + 1] = {};
+		std::snprintf(payload, sizeof(payload), "BENCH %u", i % 100000000);
+
+		auto start = bench_clock::now();
+		radio.transmit(payload, rf_transport::FRAME_SIZE);
+		tx_stats.add(bench_clock::now() - start);
+
+		// Emulator echoes the frame back
+		if (radio.receive(msg, std::chrono::milliseconds(500))) {
+			auto end = bench_clock::now();
+			turnaround_stats.add(end - start);
+			wakeup_stats.add(end - msg.arrival);
+		}
+	}
+
+	radio.reactor_off();
+
+	configure_stats.print("configure()");
+	cached_stats.print("configure() cached");
+	tx_stats.print("transmit()");
+	turnaround_stats.print("RX turnaround");
+	wakeup_stats.print("RX wake-up");
+	return 0;
+}
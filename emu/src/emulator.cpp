@@ -0,0 +1,297 @@
+/**
+ * @file src/emulator.cpp
+ * @brief DRF7020D20 module emulator on a pseudo-terminal.
+ *
+ * Speaks the WR/PARA configuration dialect while SET is low. In data mode,
+ * every received frame is echoed back after its airtime there and back, as
+ * if a peer answered immediately. AUX is driven through a gpio-sim chip.
+ */
+#include <chrono>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <poll.h>
+#include <string>
+#include <termios.h>
+#include <thread>
+#include <unistd.h>
+
+using emu_clock = std::chrono::steady_clock;
+
+// Must match the bench program
+static constexpr uint32_t AUX_LINE = 1;
+static constexpr uint32_t SET_LINE = 2;
+
+static constexpr size_t FRAME_SIZE = 15;
+static constexpr uint32_t RATES[] = {
+	1200, 2400, 4800, 9600, 19200, 38400, 57600};
+
+struct module_config {
+	uint32_t freq;
+	uint32_t fsk_rate;
+	uint32_t power_level;
+	uint32_t uart_rate;
+	uint32_t parity;
+};
+
+struct pending_frame {
+	emu_clock::time_point due;
+	std::string data;
+};
+
+static int open_pty(const std::string &link);
+static bool set_mode(const std::optional<std::string> &sysfs);
+static void set_aux(const std::optional<std::string> &sysfs, bool high);
+static std::optional<std::string> handle_command(
+	const std::string &line, module_config &config);
+static std::chrono::nanoseconds airtime(const module_config &config);
+static bool write_all(int fd, const std::string &data);
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		std::cerr << "Usage: " << argv[0]
+				  << " <serial link> [gpio-sim sysfs dir] [reply delay ms]\n";
+		return 1;
+	}
+
+	std::string link = argv[1];
+	std::optional<std::string> sysfs = std::nullopt;
+	if (argc > 2) {
+		sysfs = argv[2];
+	}
+	auto reply_delay =
+		std::chrono::milliseconds(argc > 3 ? std::atoi(argv[3]) : 0);
+
+	int master = open_pty(link);
+	if (master < 0) {
+		std::cerr << "Failed to create pseudo-terminal\n";
+		return 1;
+	}
+	std::cout << "Serial device: " << link << std::endl;
+
+	module_config config = {
+		.freq = 433900,
+		.fsk_rate = 3,
+		.power_level = 9,
+		.uart_rate = 3,
+		.parity = 0,
+	};
+	set_aux(sysfs, true);
+
+	std::string command;
+	std::string frame;
+	std::deque<pending_frame> echoes;
+
+	while (true) {
+		// Sleep until input or the next echo
+		int timeout = -1;
+		if (!echoes.empty()) {
+			auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(
+				echoes.front().due - emu_clock::now());
+			timeout = wait.count() < 0 ? 0 : (int)wait.count();
+		}
+
+		pollfd master_poll = {.fd = master, .events = POLLIN, .revents = 0};
+		int ready = poll(&master_poll, 1, timeout);
+		if (ready < 0) {
+			break;
+		}
+
+		if ((master_poll.revents & POLLIN) != 0) {
+			char buffer[256];
+			ssize_t length = read(master, buffer, sizeof(buffer));
+			if (length < 0) {
+				// Slave side not open yet
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+				continue;
+			}
+
+			if (set_mode(sysfs) || !command.empty() ||
+				std::strncmp(buffer, "WR", 2) == 0) {
+				command.append(buffer, length);
+			} else {
+				frame.append(buffer, length);
+			}
+
+			// Configuration commands end with CRLF
+			size_t end = 0;
+			while ((end = command.find("\r\n")) != std::string::npos) {
+				auto reply = handle_command(command.substr(0, end), config);
+				command.erase(0, end + 2);
+				if (reply.has_value()) {
+					std::this_thread::sleep_for(reply_delay);
+					if (!write_all(master, *reply)) {
+						std::cerr << "Failed to write reply: "
+								  << std::strerror(errno) << std::endl;
+					}
+				}
+			}
+
+			// Data goes out in whole frames and comes back later
+			while (frame.length() >= FRAME_SIZE) {
+				echoes.push_back({
+					.due = emu_clock::now() + airtime(config) * 2,
+					.data = frame.substr(0, FRAME_SIZE),
+				});
+				frame.erase(0, FRAME_SIZE);
+			}
+		}
+
+		while (!echoes.empty() && echoes.front().due <= emu_clock::now()) {
+			const auto &echo = echoes.front();
+
+			// AUX drops while the module outputs received data
+			set_aux(sysfs, false);
+			if (!write_all(master, echo.data)) {
+				std::cerr << "Failed to write frame: " << std::strerror(errno)
+						  << std::endl;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			set_aux(sysfs, true);
+
+			echoes.pop_front();
+		}
+	}
+
+	close(master);
+	unlink(link.c_str());
+	return 0;
+}
+
+/**
+ * @brief Create a raw pseudo-terminal and link its slave side.
+ *
+ * @param[in] link - Symlink path for the slave device.
+ * @return Master file descriptor, negative on error.
+ */
+int open_pty(const std::string &link) {
+	int master = posix_openpt(O_RDWR | O_NOCTTY);
+	if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0) {
+		return -1;
+	}
+
+	struct termios settings;
+	tcgetattr(master, &settings);
+	cfmakeraw(&settings);
+	tcsetattr(master, TCSANOW, &settings);
+
+	unlink(link.c_str());
+	if (symlink(ptsname(master), link.c_str()) < 0) {
+		close(master);
+		return -1;
+	}
+
+	return master;
+}
+
+/**
+ * @brief Write a whole buffer, waiting out a full PTY.
+ *
+ * @param[in] fd - File descriptor.
+ * @param[in] data - Data to write.
+ * @return False on error, errno is set.
+ */
+bool write_all(int fd, const std::string &data) {
+	size_t written = 0;
+	while (written < data.length()) {
+		ssize_t length =
+			write(fd, data.data() + written, data.length() - written);
+		if (length >= 0) {
+			written += length;
+			continue;
+		}
+
+		if (errno == EINTR) {
+			continue;
+		}
+		if (errno != EAGAIN && errno != EWOULDBLOCK) {
+			return false;
+		}
+
+		pollfd out_poll = {.fd = fd, .events = POLLOUT, .revents = 0};
+		if (poll(&out_poll, 1, -1) < 0 && errno != EINTR) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * @brief Check if the module is in configuration mode.
+ *
+ * @param[in] sysfs - gpio-sim chip sysfs directory.
+ * @return True if SET is low.
+ */
+bool set_mode(const std::optional<std::string> &sysfs) {
+	if (!sysfs.has_value()) {
+		return false;
+	}
+
+	std::ifstream value(*sysfs + "/sim_gpio" + std::to_string(SET_LINE) +
+						"/value");
+	int level = 1;
+	value >> level;
+	return level == 0;
+}
+
+/**
+ * @brief Drive the AUX line.
+ *
+ * @param[in] sysfs - gpio-sim chip sysfs directory.
+ * @param[in] high - Line level.
+ */
+void set_aux(const std::optional<std::string> &sysfs, bool high) {
+	if (!sysfs.has_value()) {
+		return;
+	}
+
+	std::ofstream pull(
+		*sysfs + "/sim_gpio" + std::to_string(AUX_LINE) + "/pull");
+	pull << (high ? "pull-up" : "pull-down") << std::flush;
+}
+
+/**
+ * @brief Apply a configuration command.
+ *
+ * @param[in] line - Command without CRLF.
+ * @param[in,out] config - Module configuration.
+ * @return Reply to send, if any.
+ */
+std::optional<std::string> handle_command(
+	const std::string &line, module_config &config) {
+	module_config update;
+	if (std::sscanf(line.c_str(), "WR %u %u %u %u %u", &update.freq,
+			&update.fsk_rate, &update.power_level, &update.uart_rate,
+			&update.parity) != 5) {
+		return std::nullopt;
+	}
+
+	if (update.freq < 418000 || update.freq > 455000 || update.fsk_rate > 6 ||
+		update.power_level > 9 || update.uart_rate > 6 || update.parity > 2) {
+		return "ERROR\r\n";
+	}
+
+	config = update;
+	char reply[32];
+	std::snprintf(reply, 32, "PARA %u %u %u %u %u\r\n", config.freq,
+		config.fsk_rate, config.power_level, config.uart_rate, config.parity);
+	return reply;
+}
+
+/**
+ * @brief Time one frame spends on the air.
+ *
+ * @param[in] config - Module configuration.
+ * @return Airtime.
+ */
+std::chrono::nanoseconds airtime(const module_config &config) {
+	return std::chrono::nanoseconds(
+		(uint64_t)FRAME_SIZE * 8 * 1000000000 / RATES[config.fsk_rate]);
+}
@@ -0,0 +1,719 @@
+/**
+ * @file include/airv2.hpp
+ * @brief AIRv2 binary message codec.
+ */
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include <driver/transport.hpp>
+
+#include "crc.hpp"
+#include "fec.hpp"
+
+/**
+ * @brief Encodes and decodes AIRv2 messages, one per radio frame.
+ * @note Wire layout:
+ * byte 0 - 1ttt llll: marker bit, message type, ID length
+ * byte 1 - session token, 0 if none
+ * byte 2 - sequence number
+ * byte 3 - argument, depends on the type
+ * bytes 4-12 - ID, 6 bits per character, only until a session is assigned;
+ * COMMAND frames carry the timing offset of the car's last frame in byte 4,
+ * REQUEST frames may carry the car's right & left turn times in bytes 4-5
+ * bytes 13-14 - CRC-16/CCITT-FALSE of bytes 0-12, big endian, or Reed-Solomon
+ * parity on links using forward error correction, see framecheck.hpp
+ * The marker bit keeps AIRv2 frames apart from ASCII AIRv1.0 messages.
+ *
+ * BUNDLE frames carry up to BUNDLE_SIZE messages without an ID of one
+ * session. The ID length is the message count, bytes 2-9 hold type,
+ * sequence number, argument & first ID byte of each message.
+ *
+ * BEACON frames open every TDMA frame in SPEC_BEACON timing. The sequence
+ * number is the frame index in the slot cycle, the argument the slot count,
+ * bytes 4-7 hold 2 bits per slot: 0 for no session, command + 1 otherwise.
+ * In SPEC_DYNAMIC timing bytes 8-9 flag the slots open to slot requests,
+ * one bit per slot, bytes 10-11 hold the nonces of up to GRANTS requests
+ * granted, 0 for none, and byte 12 their timeslots, 4 bits each. Cars
+ * request a slot with a REQUEST without a session in the contention slot
+ * or in an open slot, the nonce in the sequence number. Control answers
+ * the latter in the same slot a frame later with a CONTROL_ID without a
+ * session or ID, echoing the nonce, the granted slot in the argument.
+ */
+class airv2 {
+public:
+	enum type : uint8_t {
+		// Reply to a check in: control ID, offset argument
+		CONTROL_ID,
+		// Car ID, position argument
+		REQUEST,
+		// Command argument
+		COMMAND,
+		ACKNOWLEDGE,
+		CLEAR,
+		// Control ID
+		UNSUPPORTED,
+		// Messages sharing one frame
+		BUNDLE,
+		// Command of every slot, sent by control
+		BEACON,
+		TYPE_COUNT
+	};
+
+	enum command : uint8_t {
+		STANDBY,
+		GO_REQUESTED,
+		FINAL
+	};
+
+	static constexpr size_t MAX_ID_LENGTH = 12;
+	static constexpr size_t ID_BYTES = (MAX_ID_LENGTH * 6 + 7) / 8;
+	static constexpr size_t BUNDLE_SIZE = 2;
+	static constexpr size_t BEACON_SLOTS = 16;
+	static constexpr size_t GRANTS = 2;
+	// Beacons a car in standby listens to for its go before it clears
+	static constexpr uint32_t STANDBY_BEACONS = 100;
+	static constexpr auto TURN_UNIT = std::chrono::milliseconds(20);
+
+	/**
+	 * @brief One message as laid out on the air.
+	 */
+	struct frame {
+		uint8_t header;
+		uint8_t session;
+		uint8_t seq;
+		uint8_t arg;
+		std::array<uint8_t, ID_BYTES> id;
+		std::array<uint8_t, 2> crc;
+	};
+
+	static_assert(sizeof(frame) == rf_transport::FRAME_SIZE,
+		"AIRv2 message must fill exactly one frame");
+
+	/**
+	 * @brief How long a car takes through the intersection.
+	 */
+	struct turn_times {
+		// Entry to the next position
+		std::chrono::milliseconds right;
+		// Entry to the position before
+		std::chrono::milliseconds left;
+	};
+
+	/**
+	 * @brief Create a message without an ID.
+	 *
+	 * @param[in] kind - Message type.
+	 * @param[in] session - Session token.
+	 * @param[in] seq - Sequence number.
+	 * @param[in] arg - Argument.
+	 * @return Message, CRC not filled in.
+	 */
+	static constexpr frame make(
+		type kind, uint8_t session, uint8_t seq, uint8_t arg) {
+		return {
+			.header = (uint8_t)(MARKER | kind << 4),
+			.session = session,
+			.seq = seq,
+			.arg = arg,
+			.id = {},
+			.crc = {},
+		};
+	}
+
+	/**
+	 * @brief Get the message type.
+	 *
+	 * @param[in] msg - Message.
+	 * @return Message type.
+	 */
+	static constexpr type get_type(const frame &msg) {
+		return (type)((msg.header & ~MARKER) >> 4);
+	}
+
+	/**
+	 * @brief Pack an ID into a message.
+	 *
+	 * @param[in,out] msg - Message.
+	 * @param[in] id - ID, validate_id() rules.
+	 * @return False if the ID cannot be packed.
+	 */
+	static constexpr bool set_id(frame &msg, std::string_view id) {
+		if (id.length() > MAX_ID_LENGTH) {
+			return false;
+		}
+
+		msg.id = {};
+		for (size_t i = 0; i < id.length(); i++) {
+			auto symbol = to_symbol(id[i]);
+			if (!symbol.has_value()) {
+				return false;
+			}
+
+			// 6 bits from the top of a 16 bit window
+			size_t bit = i * 6;
+			auto window = (uint16_t)(*symbol << (10 - bit % 8));
+			msg.id[bit / 8] |= (uint8_t)(window >> 8);
+			if (bit / 8 + 1 < ID_BYTES) {
+				msg.id[bit / 8 + 1] |= (uint8_t)window;
+			}
+		}
+
+		msg.header = (uint8_t)((msg.header & 0xF0) | id.length());
+		return true;
+	}
+
+	/**
+	 * @brief Unpack the ID of a message without allocating.
+	 *
+	 * @param[in] msg - Message.
+	 * @param[out] out - ID characters.
+	 * @return ID length.
+	 */
+	static constexpr size_t get_id(
+		const frame &msg, std::span<char, MAX_ID_LENGTH> out) {
+		size_t length = msg.header & 0x0F;
+		for (size_t i = 0; i < length; i++) {
+			size_t bit = i * 6;
+			uint16_t window = msg.id[bit / 8] << 8;
+			if (bit / 8 + 1 < ID_BYTES) {
+				window |= msg.id[bit / 8 + 1];
+			}
+			out[i] = SYMBOLS[(window >> (10 - bit % 8)) & 0x3F];
+		}
+
+		return length;
+	}
+
+	/**
+	 * @brief Create the session token of a timeslot.
+	 * @note The generation tells apart consecutive sessions in one slot.
+	 *
+	 * @param[in] slot - Timeslot (0-15).
+	 * @param[in] generation - Sessions started so far in the slot.
+	 * @return Session token, never 0.
+	 */
+	static constexpr uint8_t make_session(uint32_t slot, uint32_t generation) {
+		return (uint8_t)((generation % 15 + 1) << 4 | (slot & 0x0F));
+	}
+
+	/**
+	 * @brief Get the timeslot a session is bound to.
+	 *
+	 * @param[in] session - Session token.
+	 * @return Timeslot, usable as an array index.
+	 */
+	static constexpr uint32_t session_slot(uint8_t session) {
+		return session & 0x0F;
+	}
+
+	/**
+	 * @brief Attach timing feedback to a message without an ID.
+	 *
+	 * @param[in,out] msg - Message.
+	 * @param[in] offset - Offset, positive if the car transmitted late.
+	 */
+	static constexpr void set_feedback(
+		frame &msg, std::chrono::nanoseconds offset) {
+		msg.id[0] = pack_offset(offset);
+	}
+
+	/**
+	 * @brief Get timing feedback of a message without an ID.
+	 *
+	 * @param[in] msg - Message.
+	 * @return Offset.
+	 */
+	static constexpr std::chrono::nanoseconds get_feedback(const frame &msg) {
+		return unpack_offset(msg.id[0]);
+	}
+
+	/**
+	 * @brief Pack a request argument.
+	 *
+	 * @param[in] current_pos - Current position (0-15).
+	 * @param[in] desired_pos - Desired position (0-15).
+	 * @return Argument byte.
+	 */
+	static constexpr uint8_t positions(
+		uint8_t current_pos, uint8_t desired_pos) {
+		return (uint8_t)((current_pos & 0x0F) << 4 | (desired_pos & 0x0F));
+	}
+
+	static constexpr uint8_t current_pos(uint8_t arg) {
+		return arg >> 4;
+	}
+
+	static constexpr uint8_t desired_pos(uint8_t arg) {
+		return arg & 0x0F;
+	}
+
+	/**
+	 * @brief Pack a timing offset argument.
+	 * @note Signed, in 0.25 ms steps. Clamped to the range.
+	 *
+	 * @param[in] offset - Offset, positive if the car transmitted late.
+	 * @return Argument byte.
+	 */
+	static constexpr uint8_t pack_offset(std::chrono::nanoseconds offset) {
+		auto half = offset < std::chrono::nanoseconds::zero() ? -OFFSET_UNIT / 2
+															  : OFFSET_UNIT / 2;
+		int64_t steps = (offset + half) / OFFSET_UNIT;
+		steps = steps < INT8_MIN ? INT8_MIN : steps;
+		steps = steps > INT8_MAX ? INT8_MAX : steps;
+		return (uint8_t)(int8_t)steps;
+	}
+
+	static constexpr std::chrono::nanoseconds unpack_offset(uint8_t arg) {
+		return OFFSET_UNIT * (int8_t)arg;
+	}
+
+	/**
+	 * @brief Check if a message can share a frame with others.
+	 *
+	 * @param[in] msg - Message.
+	 * @return True if it has no ID beyond the first byte.
+	 */
+	static constexpr bool can_bundle(const frame &msg) {
+		if (get_type(msg) >= BUNDLE || (msg.header & 0x0F) != 0) {
+			return false;
+		}
+
+		for (size_t i = 1; i < ID_BYTES; i++) {
+			if (msg.id[i] != 0) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/**
+	 * @brief Put two messages of one session into one frame.
+	 *
+	 * @param[in] first - Message handled first by the receiver.
+	 * @param[in] second - Message handled second.
+	 * @return Bundle, std::nullopt if the messages cannot share a frame.
+	 */
+	static constexpr std::optional<frame> bundle(
+		const frame &first, const frame &second) {
+		if (!can_bundle(first) || !can_bundle(second) ||
+			first.session != second.session) {
+			return std::nullopt;
+		}
+
+		auto msg = make(BUNDLE, first.session, 0, 0);
+		msg.header |= (uint8_t)BUNDLE_SIZE;
+		const frame *parts[BUNDLE_SIZE] = {&first, &second};
+		for (size_t i = 0; i < BUNDLE_SIZE; i++) {
+			payload_at(msg, i * RECORD_SIZE) = get_type(*parts[i]);
+			payload_at(msg, i * RECORD_SIZE + 1) = parts[i]->seq;
+			payload_at(msg, i * RECORD_SIZE + 2) = parts[i]->arg;
+			payload_at(msg, i * RECORD_SIZE + 3) = parts[i]->id[0];
+		}
+		return msg;
+	}
+
+	/**
+	 * @brief Split a bundle into its messages.
+	 *
+	 * @param[in] msg - Bundle.
+	 * @param[out] out - Messages in order.
+	 * @return Message count, 0 if not a valid bundle.
+	 */
+	static constexpr size_t unbundle(
+		const frame &msg, std::span<frame, BUNDLE_SIZE> out) {
+		size_t count = msg.header & 0x0F;
+		if (get_type(msg) != BUNDLE || count > BUNDLE_SIZE) {
+			return 0;
+		}
+
+		for (size_t i = 0; i < count; i++) {
+			uint8_t kind = payload_at(msg, i * RECORD_SIZE);
+			if (kind >= BUNDLE) {
+				return 0;
+			}
+
+			out[i] = make((type)kind, msg.session,
+				payload_at(msg, i * RECORD_SIZE + 1),
+				payload_at(msg, i * RECORD_SIZE + 2));
+			out[i].id[0] = payload_at(msg, i * RECORD_SIZE + 3);
+		}
+		return count;
+	}
+
+	/**
+	 * @brief Create a beacon with every slot idle.
+	 *
+	 * @param[in] frame_index - Index of the TDMA frame in the slot cycle.
+	 * @param[in] slot_count - Timeslots in the scheme.
+	 * @return Beacon, CRC not filled in.
+	 */
+	static constexpr frame make_beacon(
+		uint8_t frame_index, uint8_t slot_count) {
+		return make(BEACON, 0, frame_index, slot_count);
+	}
+
+	/**
+	 * @brief Set the command of a slot in a beacon.
+	 *
+	 * @param[in,out] msg - Beacon.
+	 * @param[in] slot - Timeslot (0-15).
+	 * @param[in] state - Command, std::nullopt if no session.
+	 */
+	static constexpr void set_slot_state(
+		frame &msg, uint32_t slot, std::optional<command> state) {
+		uint8_t &byte = msg.id[slot / 4];
+		uint32_t shift = (slot % 4) * 2;
+		uint8_t bits = state.has_value() ? *state + 1 : 0;
+		byte = (uint8_t)((byte & ~(0x03 << shift)) | bits << shift);
+	}
+
+	/**
+	 * @brief Get the command of a slot from a beacon.
+	 *
+	 * @param[in] msg - Beacon.
+	 * @param[in] slot - Timeslot (0-15).
+	 * @return Command, std::nullopt if no session.
+	 */
+	static constexpr std::optional<command> get_slot_state(
+		const frame &msg, uint32_t slot) {
+		uint32_t bits = msg.id[slot / 4] >> (slot % 4) * 2 & 0x03;
+		if (bits == 0) {
+			return std::nullopt;
+		}
+
+		return (command)(bits - 1);
+	}
+
+	/**
+	 * @brief Set the slots open to slot requests in a beacon.
+	 *
+	 * @param[in,out] msg - Beacon.
+	 * @param[in] slots - Bit per timeslot (0-15).
+	 */
+	static constexpr void set_open_slots(frame &msg, uint16_t slots) {
+		msg.id[OPEN_OFFSET] = (uint8_t)(slots >> 8);
+		msg.id[OPEN_OFFSET + 1] = (uint8_t)slots;
+	}
+
+	/**
+	 * @brief Get the slots open to slot requests from a beacon.
+	 *
+	 * @param[in] msg - Beacon.
+	 * @return Bit per timeslot (0-15).
+	 */
+	static constexpr uint16_t get_open_slots(const frame &msg) {
+		return (uint16_t)(msg.id[OPEN_OFFSET] << 8 | msg.id[OPEN_OFFSET + 1]);
+	}
+
+	/**
+	 * @brief Grant a timeslot to a car in a beacon.
+	 *
+	 * @param[in,out] msg - Beacon.
+	 * @param[in] index - Grant in the beacon (0 to GRANTS - 1).
+	 * @param[in] nonce - Nonce of the car's slot request, never 0.
+	 * @param[in] slot - Granted timeslot (0-15).
+	 */
+	static constexpr void set_grant(
+		frame &msg, size_t index, uint8_t nonce, uint32_t slot) {
+		uint8_t &slots = msg.id[GRANT_OFFSET + GRANTS];
+		uint32_t shift = index * 4;
+		msg.id[GRANT_OFFSET + index] = nonce;
+		slots = (uint8_t)((slots & ~(0x0F << shift)) | (slot & 0x0F) << shift);
+	}
+
+	/**
+	 * @brief Look for a car's grant in a beacon.
+	 *
+	 * @param[in] msg - Beacon.
+	 * @param[in] nonce - Nonce of the car's slot request, never 0.
+	 * @return Granted timeslot, std::nullopt if no grant is ours.
+	 */
+	static constexpr std::optional<uint32_t> get_grant(
+		const frame &msg, uint8_t nonce) {
+		for (size_t i = 0; nonce != 0 && i < GRANTS; i++) {
+			if (msg.id[GRANT_OFFSET + i] == nonce) {
+				return msg.id[GRANT_OFFSET + GRANTS] >> i * 4 & 0x0F;
+			}
+		}
+		return std::nullopt;
+	}
+
+	/**
+	 * @brief Attach the car's turn times to a request.
+	 * @note Rounded up to TURN_UNIT, at most 255 units.
+	 *
+	 * @param[in,out] msg - Request.
+	 * @param[in] times - Turn times, delay before turning included.
+	 */
+	static constexpr void set_turn_times(frame &msg, const turn_times &times) {
+		msg.id[TURN_OFFSET] = pack_turn(times.right);
+		msg.id[TURN_OFFSET + 1] = pack_turn(times.left);
+	}
+
+	/**
+	 * @brief Get the car's turn times from a request.
+	 *
+	 * @param[in] msg - Request.
+	 * @return Turn times, std::nullopt if the car sent none.
+	 */
+	static constexpr std::optional<turn_times> get_turn_times(
+		const frame &msg) {
+		if (msg.id[TURN_OFFSET] == 0 || msg.id[TURN_OFFSET + 1] == 0) {
+			return std::nullopt;
+		}
+
+		return turn_times{
+			.right = TURN_UNIT * msg.id[TURN_OFFSET],
+			.left = TURN_UNIT * msg.id[TURN_OFFSET + 1],
+		};
+	}
+
+	/**
+	 * @brief Check if a frame holds an AIRv2 message.
+	 * @note Only looks at the marker, decode() does the full check.
+	 *
+	 * @param[in] data - Frame contents.
+	 * @return True if AIRv2.
+	 */
+	static constexpr bool is_airv2(std::span<const uint8_t> data) {
+		return !data.empty() && (data[0] & MARKER) != 0;
+	}
+
+	/**
+	 * @brief Check if a frame holds a slot request.
+	 * @note Only looks at the header, decode() does the full check.
+	 *
+	 * @param[in] data - Frame contents.
+	 * @return True if a REQUEST without a session.
+	 */
+	static constexpr bool is_slot_request(std::span<const uint8_t> data) {
+		return data.size() > 1 && is_airv2(data) &&
+			   (data[0] & ~MARKER) >> 4 == REQUEST && data[1] == 0;
+	}
+
+	/**
+	 * @brief Serialize a message, filling in the CRC.
+	 *
+	 * @param[in] msg - Message.
+	 * @param[out] out - Frame contents.
+	 */
+	static constexpr void encode(
+		const frame &msg, std::span<uint8_t, rf_transport::FRAME_SIZE> out) {
+		out[0] = msg.header;
+		out[1] = msg.session;
+		out[2] = msg.seq;
+		out[3] = msg.arg;
+		for (size_t i = 0; i < ID_BYTES; i++) {
+			out[4 + i] = msg.id[i];
+		}
+
+		uint16_t crc = crc16(out.first(CRC_OFFSET));
+		out[CRC_OFFSET] = (uint8_t)(crc >> 8);
+		out[CRC_OFFSET + 1] = (uint8_t)crc;
+	}
+
+	/**
+	 * @brief Serialize a message for tdma::tx_sync() and tdma::tx_async().
+	 * @note Fits the small string buffer, so does not allocate.
+	 *
+	 * @param[in] msg - Message.
+	 * @return Frame contents.
+	 */
+	static inline std::string encode(const frame &msg) {
+		std::array<uint8_t, rf_transport::FRAME_SIZE> data = {};
+		encode(msg, data);
+		return {reinterpret_cast<const char *>(data.data()), data.size()};
+	}
+
+	/**
+	 * @brief Parse a message without allocating.
+	 * @note Accepts either trailer.
+	 *
+	 * @param[in] data - Frame contents.
+	 * @return Message, or std::nullopt if not a valid AIRv2 message.
+	 */
+	static constexpr std::optional<frame> decode(
+		std::span<const uint8_t> data) {
+		if (data.size() != rf_transport::FRAME_SIZE || !is_airv2(data)) {
+			return std::nullopt;
+		}
+
+		uint16_t crc = crc16(data.first(CRC_OFFSET));
+		bool crc_valid = data[CRC_OFFSET] == (uint8_t)(crc >> 8) &&
+						 data[CRC_OFFSET + 1] == (uint8_t)crc;
+		if (!crc_valid && !rs_check(data.first<rf_transport::FRAME_SIZE>())) {
+			return std::nullopt;
+		}
+
+		frame msg = {
+			.header = data[0],
+			.session = data[1],
+			.seq = data[2],
+			.arg = data[3],
+			.id = {},
+			.crc = {data[CRC_OFFSET], data[CRC_OFFSET + 1]},
+		};
+		for (size_t i = 0; i < ID_BYTES; i++) {
+			msg.id[i] = data[4 + i];
+		}
+
+		if (get_type(msg) >= TYPE_COUNT ||
+			(msg.header & 0x0F) > MAX_ID_LENGTH) {
+			return std::nullopt;
+		}
+
+		return msg;
+	}
+
+private:
+	static constexpr uint8_t MARKER = 0x80;
+	static constexpr size_t CRC_OFFSET = 4 + ID_BYTES;
+	// Type, sequence number, argument & first ID byte
+	static constexpr size_t RECORD_SIZE = 4;
+	static_assert(BUNDLE_SIZE * RECORD_SIZE <= 2 + ID_BYTES,
+		"Bundled messages must fit between session and CRC");
+	// Open slots after the slot states, then the grants
+	static constexpr size_t OPEN_OFFSET = BEACON_SLOTS * 2 / 8;
+	static constexpr size_t GRANT_OFFSET = OPEN_OFFSET + BEACON_SLOTS / 8;
+	static_assert(GRANT_OFFSET + GRANTS + (GRANTS * 4 + 7) / 8 <= ID_BYTES,
+		"Beacon must hold 2 bits per slot, open slots and the grants");
+	static constexpr auto OFFSET_UNIT = std::chrono::microseconds(250);
+	// Turn times of a request, in place of the ID
+	static constexpr size_t TURN_OFFSET = 0;
+
+	// validate_id() allows exactly 64 characters
+	static constexpr std::string_view SYMBOLS =
+		"0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz/-";
+
+	/**
+	 * @brief Pack a turn time.
+	 *
+	 * @param[in] time - Turn time.
+	 * @return Units, rounded up, 1-255.
+	 */
+	static constexpr uint8_t pack_turn(std::chrono::milliseconds time) {
+		auto units = (time + TURN_UNIT - std::chrono::milliseconds(1)) /
+					 TURN_UNIT;
+		if (units < 1) {
+			return 1;
+		}
+		return units > 255 ? 255 : (uint8_t)units;
+	}
+
+	/**
+	 * @brief Get a byte after the session token, for bundles.
+	 *
+	 * @param[in] msg - Message.
+	 * @param[in] index - Byte index, 0 is the sequence number.
+	 * @return Byte.
+	 */
+	static constexpr uint8_t &payload_at(frame &msg, size_t index) {
+		if (index == 0) {
+			return msg.seq;
+		}
+		if (index == 1) {
+			return msg.arg;
+		}
+		return msg.id[index - 2];
+	}
+
+	static constexpr uint8_t payload_at(const frame &msg, size_t index) {
+		return payload_at(const_cast<frame &>(msg), index);
+	}
+
+	static constexpr std::optional<uint8_t> to_symbol(char c) {
+		auto pos = SYMBOLS.find(c);
+		if (pos == std::string_view::npos) {
+			return std::nullopt;
+		}
+
+		return (uint8_t)pos;
+	}
+};
+
+static_assert(airv2::ID_BYTES == 9);
+static_assert([]() {
+	auto msg = airv2::make(airv2::REQUEST, 3, 7, airv2::positions(2, 11));
+	airv2::set_id(msg, "car-12/Zz90");
+
+	std::array<uint8_t, rf_transport::FRAME_SIZE> data = {};
+	airv2::encode(msg, data);
+	auto decoded = airv2::decode(data);
+
+	std::array<char, airv2::MAX_ID_LENGTH> id = {};
+	auto length = airv2::get_id(*decoded, id);
+	return decoded.has_value() && airv2::get_type(*decoded) == airv2::REQUEST &&
+		   decoded->session == 3 && decoded->seq == 7 &&
+		   airv2::desired_pos(decoded->arg) == 11 &&
+		   std::string_view(id.data(), length) == "car-12/Zz90";
+}(), "AIRv2 round trip");
+static_assert([]() {
+	std::array<uint8_t, rf_transport::FRAME_SIZE> data = {};
+	airv2::encode(airv2::make(airv2::CLEAR, 0, 0, 0), data);
+	data[3] ^= 0x10;
+	return !airv2::decode(data).has_value();
+}(), "AIRv2 corrupt frame");
+static_assert([]() {
+	auto ack = airv2::make(airv2::ACKNOWLEDGE, 0x21, 4, 0);
+	auto clear = airv2::make(airv2::CLEAR, 0x21, 5, 0);
+	auto both = airv2::bundle(ack, clear);
+
+	std::array<uint8_t, rf_transport::FRAME_SIZE> data = {};
+	airv2::encode(*both, data);
+	auto decoded = airv2::decode(data);
+
+	std::array<airv2::frame, airv2::BUNDLE_SIZE> parts = {};
+	return decoded.has_value() && airv2::unbundle(*decoded, parts) == 2 &&
+		   airv2::get_type(parts[0]) == airv2::ACKNOWLEDGE &&
+		   airv2::get_type(parts[1]) == airv2::CLEAR && parts[1].seq == 5 &&
+		   parts[1].session == 0x21;
+}(), "AIRv2 bundle round trip");
+static_assert([]() {
+	auto beacon = airv2::make_beacon(2, 16);
+	airv2::set_slot_state(beacon, 0, airv2::STANDBY);
+	airv2::set_slot_state(beacon, 15, airv2::FINAL);
+	airv2::set_slot_state(beacon, 6, airv2::GO_REQUESTED);
+	airv2::set_slot_state(beacon, 6, std::nullopt);
+	return airv2::get_slot_state(beacon, 0) == airv2::STANDBY &&
+		   airv2::get_slot_state(beacon, 15) == airv2::FINAL &&
+		   !airv2::get_slot_state(beacon, 6).has_value() &&
+		   !airv2::get_slot_state(beacon, 1).has_value();
+}(), "AIRv2 beacon slot states");
+static_assert([]() {
+	auto beacon = airv2::make_beacon(0, 8);
+	airv2::set_slot_state(beacon, 15, airv2::FINAL);
+	airv2::set_open_slots(beacon, 0x8001);
+	airv2::set_grant(beacon, 0, 0x5A, 7);
+	airv2::set_grant(beacon, 1, 0x5B, 15);
+	return airv2::get_grant(beacon, 0x5A) == 7u &&
+		   airv2::get_grant(beacon, 0x5B) == 15u &&
+		   !airv2::get_grant(beacon, 0x5C).has_value() &&
+		   !airv2::get_grant(beacon, 0).has_value() &&
+		   airv2::get_open_slots(beacon) == 0x8001 &&
+		   airv2::get_slot_state(beacon, 15) == airv2::FINAL;
+}(), "AIRv2 beacon slot grant");
+static_assert([]() {
+	auto msg = airv2::make(airv2::REQUEST, 1, 1, airv2::positions(0, 1));
+	bool empty = !airv2::get_turn_times(msg).has_value();
+	airv2::set_turn_times(msg,
+		{.right = std::chrono::milliseconds(1210),
+			.left = std::chrono::milliseconds(9000)});
+	auto times = airv2::get_turn_times(msg);
+	return empty && times.has_value() &&
+		   times->right == std::chrono::milliseconds(1220) &&
+		   times->left == std::chrono::milliseconds(5100);
+}(), "AIRv2 request turn times");
+static_assert(airv2::make_session(15, 14) == 0xFF &&
+			  airv2::make_session(3, 15) == 0x13 &&
+			  airv2::session_slot(airv2::make_session(9, 6)) == 9);
+static_assert(airv2::unpack_offset(airv2::pack_offset(
+				  std::chrono::microseconds(-1300))) ==
+			  std::chrono::microseconds(-1250));
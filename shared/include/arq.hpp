@@ -0,0 +1,162 @@
+/**
+ * @file include/arq.hpp
+ * @brief Stop-and-wait ARQ for AIRv2 sessions.
+ */
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include <driver/transport.hpp>
+
+#include "airv2.hpp"
+#include "slotclock.hpp"
+#include "tdma.hpp"
+
+/**
+ * @brief Reliable request/reply exchange in one timeslot.
+ * @note Every request carries the next sequence number of the session and
+ * its reply echoes it. An unanswered request is sent again in the next
+ * occurrence of the slot. The answering side acts on each sequence number
+ * once and answers repeats from the last reply it sent.
+ */
+class arq_session {
+public:
+	// Attempts per request, each costs one frame
+	static constexpr uint32_t MAX_TRIES = 4;
+
+	/**
+	 * @brief Constructor.
+	 *
+	 * @param[in] tdma_in - Radio of the timeslot.
+	 */
+	arq_session(const std::shared_ptr<tdma> &tdma_in);
+
+	/**
+	 * @brief Start a new session, forgetting sequence numbers and replies.
+	 *
+	 * @param[in] session_in - Session token.
+	 */
+	void reset(uint8_t session_in);
+
+	/**
+	 * @brief Get the session token.
+	 *
+	 */
+	inline uint8_t get_session() const {
+		return session;
+	}
+
+	/**
+	 * @brief Send an ASCII check in until control assigns a session.
+	 * @note Resets the session to the token in the reply.
+	 *
+	 * @param[in] msg - Check in message.
+	 * @param[in] tries - Maximum attempts.
+	 * @return CONTROL_ID reply, std::nullopt if none arrived.
+	 */
+	std::optional<airv2::frame> check_in(
+		const std::string &msg, uint32_t tries = MAX_TRIES);
+
+	/**
+	 * @brief Send a request until its reply arrives.
+	 * @note Fills in the session and sequence number.
+	 *
+	 * @param[in] msg - Request.
+	 * @param[in] reply_type - Expected reply type.
+	 * @return Reply, std::nullopt after MAX_TRIES attempts.
+	 */
+	std::optional<airv2::frame> request(
+		airv2::frame msg, airv2::type reply_type);
+
+	/**
+	 * @brief Send a message that is not answered.
+	 * @note Fills in the session and sequence number. Does not wait for
+	 * the transmission, a message still queued when the slot is destroyed
+	 * is dropped.
+	 *
+	 * @param[in] msg - Message.
+	 */
+	void post(airv2::frame msg);
+
+	/**
+	 * @brief Get the start of the last transmission, for timing feedback.
+	 *
+	 */
+	inline slot_clock::time_point get_last_sent() const {
+		return last_sent;
+	}
+
+	/**
+	 * @brief Receive the next new message of the session.
+	 * @note Repeated requests are answered from the last reply meanwhile.
+	 *
+	 * @param[in] max_frames - Maximum frames before timeout.
+	 * @return Message, std::nullopt on timeout.
+	 */
+	std::optional<airv2::frame> receive(uint32_t max_frames);
+
+	/**
+	 * @brief Return a message so the next receive() gets it again.
+	 *
+	 * @param[in] msg - Message received from receive().
+	 */
+	inline void hold(const airv2::frame &msg) {
+		held = msg;
+	}
+
+	/**
+	 * @brief Answer a frame again if it repeats the last request.
+	 *
+	 * @param[in] rx - Received frame.
+	 * @return True if it was a repeat, answered or not.
+	 */
+	bool answer_repeat(const rf_transport::frame &rx);
+
+	/**
+	 * @brief Answer the last received request.
+	 * @note Echoes its sequence number and keeps a copy for repeats. Sent
+	 * in the next occurrence of the slot.
+	 *
+	 * @param[in] msg - Reply.
+	 */
+	void reply(airv2::frame msg);
+
+	/**
+	 * @brief Get the number of requests sent again.
+	 *
+	 */
+	inline uint64_t get_retransmissions() const {
+		return retransmissions;
+	}
+
+	/**
+	 * @brief Get the number of repeated requests received.
+	 *
+	 */
+	inline uint64_t get_repeats() const {
+		return repeats;
+	}
+
+private:
+	/**
+	 * @brief Send one frame now and note when.
+	 *
+	 * @param[in] encoded - Frame contents.
+	 */
+	void transmit(const std::string &encoded);
+
+	std::shared_ptr<tdma> tdma_handler;
+	uint8_t session = 0;
+	// Last sequence number sent and last one acted on, 0 for none
+	uint8_t tx_seq = 0;
+	uint8_t rx_seq = 0;
+	std::optional<std::string> last_reply;
+	std::optional<airv2::frame> held;
+	slot_clock::time_point last_sent;
+
+	uint64_t retransmissions = 0;
+	uint64_t repeats = 0;
+};
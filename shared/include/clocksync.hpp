@@ -0,0 +1,70 @@
+/**
+ * @file include/clocksync.hpp
+ * @brief Slot clock offset and drift tracking from control feedback.
+ */
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+
+#include "slotclock.hpp"
+
+/**
+ * @brief Proportional-integral loop steering the slot clock.
+ * @note Each measurement is the transmission start error control saw. The
+ * proportional part moves the epoch right away, the integral part estimates
+ * oscillator drift and lets the epoch follow it between measurements.
+ */
+class clock_sync {
+public:
+	/**
+	 * @brief Constructor.
+	 *
+	 * @param[in] kp_in - Share of each error corrected immediately (0-1).
+	 * @param[in] ki_in - Share of each error attributed to drift.
+	 */
+	clock_sync(double kp_in = 0.5, double ki_in = 0.1);
+
+	/**
+	 * @brief Feed a measured transmission start error.
+	 *
+	 * @param[in] error - Error reported by control, positive if late.
+	 * @param[in] measured_at - Time of the measured transmission.
+	 */
+	void update(std::chrono::nanoseconds error,
+		slot_clock::time_point measured_at);
+
+	/**
+	 * @brief Get the estimated drift.
+	 *
+	 * @return Drift in parts per million, positive if running late.
+	 */
+	double get_drift_ppm() const;
+
+	/**
+	 * @brief Get the total correction applied so far.
+	 *
+	 */
+	std::chrono::nanoseconds get_correction() const;
+
+	/**
+	 * @brief Get the number of measurements used.
+	 *
+	 */
+	uint32_t get_samples() const;
+
+private:
+	// Larger drift means a bad measurement, not a bad oscillator
+	static constexpr double MAX_DRIFT = 500e-6;
+
+	double kp;
+	double ki;
+
+	mutable std::mutex lock;
+	std::optional<slot_clock::time_point> last_measurement = std::nullopt;
+	double drift = 0.0;
+	std::chrono::nanoseconds correction = std::chrono::nanoseconds(0);
+	uint32_t samples = 0;
+};
@@ -0,0 +1,33 @@
+/**
+ * @file include/contention.hpp
+ * @brief Check in slot requests for SPEC_DYNAMIC timing.
+ */
+#pragma once
+
+#include <cstdint>
+#include <optional>
+
+#include "tdma.hpp"
+
+// Slot requests before giving up
+inline constexpr uint32_t CONTENTION_TRIES = 8;
+// Beacons to wait for a grant, the contention slot passes at most one
+// request per frame and a beacon holds airv2::GRANTS
+inline constexpr uint32_t GRANT_FRAMES = 2;
+
+/**
+ * @brief Ask control for a data slot.
+ * @note Slotted ALOHA over the contention slot and every slot the beacon
+ * lists as open, so queued cars mostly ask in different slots. Control
+ * grants an open slot to the car asking in it, answering there a frame
+ * later, and grants from the contention slot in the beacon. Colliding cars
+ * back off a random number of frames, doubling the range each attempt. On
+ * success the radio is moved to the granted slot.
+ *
+ * @param[in,out] car_slot - Radio slot of the car.
+ * @param[in] beacon - Beacon slot on the same radio.
+ * @param[in] position - Position of the car.
+ * @return Granted timeslot, std::nullopt after CONTENTION_TRIES attempts.
+ */
+std::optional<uint32_t> request_slot(
+	tdma &car_slot, const tdma &beacon, uint8_t position);
@@ -0,0 +1,67 @@
+/**
+ * @file include/crc.hpp
+ * @brief Table-driven CRCs for frame checking.
+ */
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+/**
+ * @brief Lookup table of an MSB-first CRC, one entry per byte value.
+ *
+ * @tparam T CRC type.
+ * @tparam POLY Generator polynomial.
+ */
+template<typename T, T POLY>
+inline constexpr std::array<T, 256> CRC_TABLE = []() {
+	constexpr int SHIFT = (sizeof(T) - 1) * 8;
+	constexpr T TOP_BIT = (T)1 << (sizeof(T) * 8 - 1);
+
+	std::array<T, 256> table = {};
+	for (size_t byte = 0; byte < table.size(); byte++) {
+		auto crc = (T)(byte << SHIFT);
+		for (int bit = 0; bit < 8; bit++) {
+			crc = (crc & TOP_BIT) != 0 ? (T)(crc << 1 ^ POLY) : (T)(crc << 1);
+		}
+		table[byte] = crc;
+	}
+	return table;
+}();
+
+/**
+ * @brief CRC-8 (polynomial 0x07, initial value 0).
+ *
+ * @param[in] data - Bytes to check.
+ * @return CRC.
+ */
+constexpr uint8_t crc8(std::span<const uint8_t> data) {
+	uint8_t crc = 0;
+	for (uint8_t byte : data) {
+		crc = CRC_TABLE<uint8_t, 0x07>[crc ^ byte];
+	}
+	return crc;
+}
+
+/**
+ * @brief CRC-16/CCITT-FALSE (polynomial 0x1021, initial value 0xFFFF).
+ *
+ * @param[in] data - Bytes to check.
+ * @return CRC.
+ */
+constexpr uint16_t crc16(std::span<const uint8_t> data) {
+	uint16_t crc = 0xFFFF;
+	for (uint8_t byte : data) {
+		crc = (uint16_t)(crc << 8 ^
+						 CRC_TABLE<uint16_t, 0x1021>[(crc >> 8 ^ byte) & 0xFF]);
+	}
+	return crc;
+}
+
+// Standard check values over "123456789"
+static_assert(crc8(std::array<uint8_t, 9>{
+				  '1', '2', '3', '4', '5', '6', '7', '8', '9'}) == 0xF4);
+static_assert(crc16(std::array<uint8_t, 9>{
+				  '1', '2', '3', '4', '5', '6', '7', '8', '9'}) == 0x29B1);
@@ -0,0 +1,139 @@
+/**
+ * @file include/fec.hpp
+ * @brief Reed-Solomon forward error correction for single frames.
+ */
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+
+#include <driver/transport.hpp>
+
+// RS(15,13): data bytes first, then two parity bytes
+inline constexpr size_t FEC_PARITY_BYTES = 2;
+inline constexpr size_t FEC_DATA_BYTES =
+	rf_transport::FRAME_SIZE - FEC_PARITY_BYTES;
+
+/**
+ * @brief GF(256) log and antilog tables, primitive polynomial 0x11D.
+ * @note Antilog table is doubled so products need no modulo.
+ */
+struct gf256 {
+	std::array<uint8_t, 512> exp;
+	std::array<uint8_t, 256> log;
+};
+
+inline constexpr gf256 GF256 = []() {
+	gf256 tables = {};
+	uint32_t value = 1;
+	for (size_t i = 0; i < 255; i++) {
+		tables.exp[i] = (uint8_t)value;
+		tables.exp[i + 255] = (uint8_t)value;
+		tables.log[value] = (uint8_t)i;
+		value <<= 1;
+		if ((value & 0x100) != 0) {
+			value ^= 0x11D;
+		}
+	}
+	return tables;
+}();
+
+/**
+ * @brief Compute both syndromes of a frame.
+ * @note S0 is the sum of all bytes, S1 weighs byte i with alpha^(14-i).
+ *
+ * @param[in] data - Frame contents.
+ * @return S0, S1. Both zero for an intact frame.
+ */
+constexpr std::array<uint8_t, 2> rs_syndromes(
+	std::span<const uint8_t, rf_transport::FRAME_SIZE> data) {
+	uint8_t s0 = 0;
+	uint8_t s1 = 0;
+	for (size_t i = 0; i < data.size(); i++) {
+		s0 ^= data[i];
+		if (data[i] != 0) {
+			s1 ^= GF256.exp[GF256.log[data[i]] + data.size() - 1 - i];
+		}
+	}
+	return {s0, s1};
+}
+
+/**
+ * @brief Fill in the parity bytes of a frame.
+ *
+ * @param[in,out] data - Frame, first FEC_DATA_BYTES are encoded.
+ */
+constexpr void rs_encode(std::span<uint8_t, rf_transport::FRAME_SIZE> data) {
+	data[FEC_DATA_BYTES] = 0;
+	data[FEC_DATA_BYTES + 1] = 0;
+	auto [s0, s1] = rs_syndromes(data);
+
+	// Solve p1 + p0 = S0 and alpha * p1 + p0 = S1, alpha + 1 = 3
+	uint8_t p1 = 0;
+	if ((s0 ^ s1) != 0) {
+		p1 = GF256.exp[GF256.log[s0 ^ s1] + 255 - GF256.log[3]];
+	}
+	data[FEC_DATA_BYTES] = p1;
+	data[FEC_DATA_BYTES + 1] = s0 ^ p1;
+}
+
+/**
+ * @brief Check a frame without correcting it.
+ *
+ * @param[in] data - Frame contents.
+ * @return True if intact.
+ */
+constexpr bool rs_check(
+	std::span<const uint8_t, rf_transport::FRAME_SIZE> data) {
+	auto syndromes = rs_syndromes(data);
+	return syndromes[0] == 0 && syndromes[1] == 0;
+}
+
+/**
+ * @brief Correct a single byte error in place.
+ * @note Two byte errors are detected or, rarely, miscorrected; callers
+ * should check the message structure afterwards.
+ *
+ * @param[in,out] data - Frame contents.
+ * @return Bytes corrected (0 or 1), std::nullopt if uncorrectable.
+ */
+constexpr std::optional<uint32_t> rs_correct(
+	std::span<uint8_t, rf_transport::FRAME_SIZE> data) {
+	auto [s0, s1] = rs_syndromes(data);
+	if (s0 == 0 && s1 == 0) {
+		return 0;
+	}
+
+	// One error of size S0 at power p gives S1 = S0 * alpha^p
+	if (s0 == 0 || s1 == 0) {
+		return std::nullopt;
+	}
+	size_t power = (GF256.log[s1] + 255 - GF256.log[s0]) % 255;
+	if (power >= data.size()) {
+		return std::nullopt;
+	}
+
+	data[data.size() - 1 - power] ^= s0;
+	return 1;
+}
+
+static_assert(GF256.exp[8] == 0x1D && GF256.log[0x1D] == 8);
+static_assert([]() {
+	std::array<uint8_t, rf_transport::FRAME_SIZE> data = {
+		'A', 'C', 'K', ' ', 'F', 'I', 'N'};
+	rs_encode(data);
+	bool intact = rs_check(data);
+
+	// Every single byte error is corrected
+	for (size_t i = 0; i < data.size(); i++) {
+		auto damaged = data;
+		damaged[i] ^= 0xA5;
+		if (rs_correct(damaged) != 1 || damaged != data) {
+			return false;
+		}
+	}
+	return intact;
+}(), "RS(15,13) corrects single byte errors");
@@ -0,0 +1,84 @@
+/**
+ * @file include/framecheck.hpp
+ * @brief Frame integrity checks, applied before any message parsing.
+ */
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+
+#include <driver/transport.hpp>
+
+enum frame_coding {
+	// Detect errors with CRC trailers
+	FRAME_CRC,
+	// Correct single byte errors with Reed-Solomon parity, see fec.hpp
+	FRAME_FEC,
+	// FRAME_CRC, also taking frames without a trailer from AIRv1.0 peers
+	FRAME_CRC_LEGACY
+};
+
+/**
+ * @brief Add the check trailer to an outgoing message.
+ * @note AIRv2 messages carry their own CRC-16, replaced by parity in FEC
+ * mode. ASCII messages of up to 13 characters get a NUL and a CRC-8, or up
+ * to 11 characters parity in FEC mode. AIRv1.0 parsers stop at the NUL.
+ *
+ * @param[in] msg - Message, at most one frame.
+ * @param[in] coding - Link coding, must match the receivers.
+ * @return Message to transmit.
+ */
+std::string seal_frame(const std::string &msg, frame_coding coding = FRAME_CRC);
+
+/**
+ * @brief Check a received frame of a FRAME_CRC link.
+ * @note ASCII messages of 14 or 15 characters have no room for a trailer and
+ * are only checked for stray bytes, see get_unchecked_frames(). Short ASCII
+ * messages need their trailer unless they may come from AIRv1.0 peers.
+ *
+ * @param[in] data - Frame contents.
+ * @param[in] legacy - Take short ASCII messages without a trailer.
+ * @return False if the frame is corrupt.
+ */
+bool check_frame(std::span<const uint8_t> data, bool legacy = false);
+
+/**
+ * @brief Check a received frame of a FRAME_FEC link, fixing it if possible.
+ *
+ * @param[in,out] data - Frame contents.
+ * @return False if the frame is corrupt beyond repair.
+ */
+bool repair_frame(std::span<uint8_t> data);
+
+/**
+ * @brief Select the frame coding of a radio and install its check.
+ * @note The coding belongs to the radio, so every slot and multiplexer on
+ * it seals and checks frames the same way. Must match the rest of the
+ * fleet.
+ *
+ * @param[in] rf_dev - Radio transport.
+ * @param[in] coding - Frame coding.
+ */
+void set_link_coding(
+	const std::shared_ptr<rf_transport> &rf_dev, frame_coding coding);
+
+/**
+ * @brief Get the frame coding of a radio.
+ * @note A radio starts out as FRAME_CRC with check_frame() installed on
+ * first use. Later calls leave its check alone.
+ *
+ * @param[in] rf_dev - Radio transport.
+ * @return Frame coding.
+ */
+frame_coding get_link_coding(const std::shared_ptr<rf_transport> &rf_dev);
+
+/**
+ * @brief Get count of frames a radio passed without a trailer to check.
+ * @note Long ASCII messages, and short ones on FRAME_CRC_LEGACY links.
+ *
+ * @param[in] rf_dev - Radio transport.
+ * @return Frame count since the coding was selected.
+ */
+uint64_t get_unchecked_frames(const std::shared_ptr<rf_transport> &rf_dev);
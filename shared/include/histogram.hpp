@@ -0,0 +1,93 @@
+/**
+ * @file include/histogram.hpp
+ * @brief Lock-free fixed bucket latency histogram.
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+/**
+ * @brief Latency histogram with microsecond resolution.
+ * @note Buckets are log-linear: exact below 16 us, then 16 buckets per
+ * power of two, so every value lands within ~6% of its bucket start.
+ * Recording is a couple of relaxed atomic operations and never blocks.
+ */
+class latency_histogram {
+public:
+	/**
+	 * @brief Record a sample.
+	 * @note Negative samples count as zero.
+	 *
+	 * @param[in] sample - Measured duration.
+	 */
+	void add(std::chrono::nanoseconds sample);
+
+	/**
+	 * @brief Get the number of recorded samples.
+	 *
+	 */
+	inline uint64_t count() const {
+		return total.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * @brief Get the largest recorded sample.
+	 *
+	 */
+	inline std::chrono::microseconds max() const {
+		return std::chrono::microseconds(
+			max_us.load(std::memory_order_relaxed));
+	}
+
+	/**
+	 * @brief Estimate a percentile.
+	 *
+	 * @param[in] fraction - Percentile as a fraction (0-1).
+	 * @return Start of the bucket holding the percentile.
+	 */
+	std::chrono::microseconds percentile(double fraction) const;
+
+	/**
+	 * @brief Print count, p50, p99 and max on one line.
+	 *
+	 * @param[in] out - Output stream.
+	 * @param[in] name - Measurement name.
+	 */
+	void print(FILE *out, const char *name) const;
+
+	/**
+	 * @brief Forget all samples.
+	 *
+	 */
+	void reset();
+
+private:
+	static constexpr uint32_t SUB_BUCKETS = 16;
+	static constexpr uint32_t SUB_BITS = 4;
+	// Up to 2^32 us
+	static constexpr uint32_t BUCKETS = SUB_BUCKETS * (32 - SUB_BITS + 1);
+
+	/**
+	 * @brief Get the bucket of a value.
+	 *
+	 * @param[in] micros - Value in us.
+	 * @return Bucket index.
+	 */
+	static uint32_t bucket_of(uint64_t micros);
+
+	/**
+	 * @brief Get the smallest value of a bucket.
+	 *
+	 * @param[in] bucket - Bucket index.
+	 * @return Value in us.
+	 */
+	static uint64_t bucket_start(uint32_t bucket);
+
+	std::array<std::atomic<uint64_t>, BUCKETS> buckets = {};
+	std::atomic<uint64_t> total = 0;
+	std::atomic<uint64_t> max_us = 0;
+};
@@ -5,8 +5,10 @@
 
 #pragma once
 
+#include <chrono>
 #include <cstdint>
 #include <memory>
+#include <optional>
 #include <string>
 
 struct msg_t {
@@ -15,6 +17,45 @@ struct msg_t {
 	std::string body;
 };
 
-bool validate_header(const std::string &str);
+enum protocol_version {
+	// ASCII messages
+	AIRV1,
+	// Binary messages after an ASCII check in, see airv2.hpp
+	AIRV2
+};
+
+/**
+ * @brief Check a check in header.
+ *
+ * @param[in] str - Header.
+ * @return Protocol version the header asks for, or std::nullopt if unknown.
+ */
+std::optional<protocol_version> validate_header(const std::string &str);
+
+/**
+ * @brief Get the check in header of a protocol version.
+ *
+ * @param[in] version - Protocol version.
+ * @return Header.
+ */
+const std::string &format_header(protocol_version version);
+
 bool validate_id(const std::string &str);
 const std::shared_ptr<std::string> &get_id();
+
+/**
+ * @brief Encode a timing offset as the one byte CHK reply field.
+ * @note Printable, so it survives the ASCII framing. Clamped to the range.
+ *
+ * @param[in] offset - Offset, positive if the car transmitted late.
+ * @return One character string.
+ */
+std::string format_offset(std::chrono::nanoseconds offset);
+
+/**
+ * @brief Decode the CHK reply offset field.
+ *
+ * @param[in] str - Field contents.
+ * @return Offset, or std::nullopt if malformed.
+ */
+std::optional<std::chrono::nanoseconds> parse_offset(const std::string &str);
@@ -0,0 +1,179 @@
+/**
+ * @file include/simradio.hpp
+ * @brief Simulated shared RF channel for running without hardware.
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <driver/transport.hpp>
+
+class sim_transport;
+
+/**
+ * @brief Single radio channel shared by every attached sim_transport.
+ * @note Frames occupy the channel for their GFSK airtime. Frames overlapping
+ * in time collide and reach nobody.
+ */
+class sim_medium {
+public:
+	struct stats {
+		uint64_t sent;
+		uint64_t delivered;
+		uint64_t collided;
+		uint64_t lost;
+		uint64_t corrupted;
+	};
+
+	/**
+	 * @brief Constructor.
+	 *
+	 * @param[in] bitrate - Over the air bitrate in bps.
+	 * @param[in] loss - Chance of a frame getting lost at each receiver (0-1).
+	 * @param[in] corruption - Chance of a bit error in a frame at each
+	 * receiver (0-1).
+	 */
+	sim_medium(
+		uint32_t bitrate = 9600, double loss = 0.0, double corruption = 0.0);
+
+	~sim_medium();
+
+	/**
+	 * @brief Get channel statistics.
+	 *
+	 */
+	stats get_stats() const;
+
+	/**
+	 * @brief Time one frame occupies the channel.
+	 *
+	 */
+	inline std::chrono::nanoseconds get_airtime() const {
+		return airtime;
+	}
+
+private:
+	friend class sim_transport;
+
+	struct transmission {
+		rf_transport::frame data;
+		const sim_transport *sender;
+		rf_transport::timestamp start;
+		rf_transport::timestamp end;
+		bool collided;
+	};
+
+	/**
+	 * @brief Attach a station to the channel.
+	 *
+	 * @param[in] station - New station.
+	 */
+	void join(sim_transport *station);
+
+	/**
+	 * @brief Detach a station from the channel.
+	 * @note Waits for an ongoing delivery to finish.
+	 *
+	 * @param[in] station - Leaving station.
+	 */
+	void leave(sim_transport *station);
+
+	/**
+	 * @brief Put one frame on the air.
+	 *
+	 * @param[in] sender - Transmitting station.
+	 * @param[in] msg - Frame contents, exactly FRAME_SIZE bytes.
+	 */
+	void send(const sim_transport *sender, const char *msg);
+
+	/**
+	 * @brief Hand a finished transmission to the receivers.
+	 *
+	 * @param[in] tx - Transmission.
+	 */
+	void distribute(const transmission &tx);
+
+	/**
+	 * @brief Channel thread body.
+	 *
+	 */
+	void worker_loop();
+
+	std::chrono::nanoseconds airtime;
+	std::bernoulli_distribution loss_dist;
+	std::bernoulli_distribution corrupt_dist;
+	std::uniform_int_distribution<uint32_t> bit_dist;
+	std::mt19937 rng;
+
+	// Guards in_flight & active
+	std::mutex lock;
+	std::condition_variable cond;
+	std::deque<transmission> in_flight;
+	bool active = true;
+
+	// Guards stations, held while delivering
+	std::mutex delivery_lock;
+	std::vector<sim_transport *> stations;
+
+	std::atomic<uint64_t> sent = 0;
+	std::atomic<uint64_t> delivered = 0;
+	std::atomic<uint64_t> collided = 0;
+	std::atomic<uint64_t> lost = 0;
+	std::atomic<uint64_t> corrupted = 0;
+
+	std::unique_ptr<std::thread> worker;
+};
+
+/**
+ * @brief Radio transport on a simulated channel.
+ * @note Reception is always on, so the reactor calls do nothing.
+ */
+class sim_transport : public rf_transport {
+public:
+	/**
+	 * @brief Constructor.
+	 *
+	 * @param[in] medium_in - Channel to attach to.
+	 */
+	sim_transport(const std::shared_ptr<sim_medium> &medium_in);
+
+	~sim_transport() override;
+
+	void reactor_on() override {}
+
+	void reactor_off() override {}
+
+	std::chrono::nanoseconds get_frame_airtime() const override {
+		return medium->get_airtime();
+	}
+
+	using rf_transport::transmit;
+
+	/**
+	 * @brief Transmit message on the channel.
+	 * @note Returns once queued, like a UART write. Frames go on the air
+	 * back to back.
+	 *
+	 * @param[in] msg - Message to send.
+	 * @param[in] length - Message length.
+	 * @return Boolean result.
+	 */
+	bool transmit(const char *msg, uint32_t length) const override;
+
+private:
+	friend class sim_medium;
+
+	std::shared_ptr<sim_medium> medium;
+
+	// Guarded by medium lock
+	mutable rf_transport::timestamp busy_until;
+};
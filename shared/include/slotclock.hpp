@@ -0,0 +1,80 @@
+/**
+ * @file include/slotclock.hpp
+ * @brief Monotonic clock for TDMA slot timing.
+ */
+#pragma once
+
+#include <chrono>
+
+/**
+ * @brief Maps CLOCK_MONOTONIC onto the repeating one second slot cycle.
+ * @note The epoch is a monotonic time at which a cycle starts. It is taken
+ * from the wall clock once, so later NTP steps do not move slots; only
+ * explicit adjustments and the drift correction do.
+ */
+class slot_clock {
+public:
+	// std::chrono::steady_clock reads CLOCK_MONOTONIC
+	using clock = std::chrono::steady_clock;
+	using time_point = clock::time_point;
+
+	static constexpr auto CYCLE = std::chrono::seconds(1);
+
+	/**
+	 * @brief Get the current cycle epoch.
+	 *
+	 * @return Monotonic start time of some cycle.
+	 */
+	static time_point epoch();
+
+	/**
+	 * @brief Shift the epoch, moving every slot by the same amount.
+	 *
+	 * @param[in] correction - Amount to move slots later by.
+	 */
+	static void adjust(clock::duration correction);
+
+	/**
+	 * @brief Let the epoch move at a steady rate, to cancel oscillator drift.
+	 *
+	 * @param[in] rate - Epoch movement per unit of time, e.g. 20e-6 moves
+	 * slots 20 us later every second.
+	 */
+	static void set_drift(double rate);
+
+	/**
+	 * @brief Get the current drift correction.
+	 *
+	 */
+	static double get_drift();
+
+	/**
+	 * @brief Re-derive the epoch from the wall clock second boundary.
+	 *
+	 */
+	static void resync();
+
+	/**
+	 * @brief Get the start of the cycle a point in time falls in.
+	 *
+	 * @param[in] time - Point in time.
+	 * @return Cycle start, not after time.
+	 */
+	static time_point cycle_start(time_point time);
+
+	/**
+	 * @brief Get how far into its cycle a point in time is.
+	 *
+	 * @param[in] time - Point in time.
+	 * @return Time since the cycle start, less than CYCLE.
+	 */
+	static clock::duration cycle_offset(time_point time);
+
+	/**
+	 * @brief Sleep until an absolute monotonic deadline.
+	 *
+	 * @param[in] deadline - Wake-up time.
+	 * @return Wake-up error, how late the thread actually woke up.
+	 */
+	static clock::duration sleep_until(time_point deadline);
+};
@@ -0,0 +1,147 @@
+/**
+ * @file include/slotmux.hpp
+ * @brief Routes received frames of a shared radio to per-slot queues.
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+#include <driver/transport.hpp>
+
+#include "framecheck.hpp"
+#include "spscqueue.hpp"
+#include "tdma.hpp"
+
+/**
+ * @brief Owns the radio on behalf of every slot of a TDMA scheme.
+ * @note Frames are sorted into slots by arrival time on the radio's
+ * receiving thread, so slot workers never touch the radio for reception.
+ * With a contention slot, slot requests go to its queue from every slot.
+ */
+class slot_mux {
+public:
+	static constexpr uint32_t MAX_SLOTS = 16;
+
+	/**
+	 * @brief Constructor.
+	 *
+	 * @param[in] rf_dev_in - Radio, must not be received from elsewhere.
+	 * @param[in] div_in - TDMA scheme.
+	 * @param[in] mode_in - Slot timing.
+	 */
+	slot_mux(const std::shared_ptr<rf_transport> &rf_dev_in,
+		tdma::scheme div_in,
+		tdma::timing_mode mode_in = tdma::LEGACY);
+
+	~slot_mux();
+
+	slot_mux(const slot_mux &) = delete;
+	slot_mux &operator=(const slot_mux &) = delete;
+
+	/**
+	 * @brief Take the oldest frame received in a slot.
+	 * @note Only one thread may take frames from a given slot.
+	 *
+	 * @param[in] slot - Timeslot, or tdma::contention_slot().
+	 * @param[out] msg - Received frame.
+	 * @return False if nothing is queued.
+	 */
+	bool pop(uint32_t slot, rf_transport::frame &msg);
+
+	/**
+	 * @brief Get the timeslot a frame arrived in.
+	 *
+	 * @param[in] arrival - Frame arrival time.
+	 * @return Timeslot, tdma::slot_count() or above outside of every slot.
+	 */
+	uint32_t slot_at(rf_transport::timestamp arrival) const;
+
+	/**
+	 * @brief Adjust timing for receiving.
+	 *
+	 * @param[in] new_offset_ms - ms offset for message start.
+	 */
+	inline void set_rx_offset(int32_t new_offset_ms) {
+		rx_offset_ms = new_offset_ms;
+	}
+
+	/**
+	 * @brief Get the radio, for transmitting.
+	 *
+	 */
+	inline const std::shared_ptr<rf_transport> &get_transport() const {
+		return rf_dev;
+	}
+
+	/**
+	 * @brief Get the TDMA scheme.
+	 *
+	 */
+	inline tdma::scheme get_scheme() const {
+		return div;
+	}
+
+	/**
+	 * @brief Get the slot timing.
+	 *
+	 */
+	inline tdma::timing_mode get_mode() const {
+		return mode;
+	}
+
+	/**
+	 * @brief Select error detection or correction for the radio.
+	 * @note Every slot on the radio uses the same coding, see
+	 * set_link_coding().
+	 *
+	 * @param[in] coding - Frame coding.
+	 */
+	void set_coding(frame_coding coding);
+
+	/**
+	 * @brief Get the frame coding.
+	 *
+	 */
+	frame_coding get_coding() const;
+
+	/**
+	 * @brief Get count of frames outside any slot or over queue capacity.
+	 *
+	 */
+	inline uint64_t get_dropped() const {
+		return dropped;
+	}
+
+private:
+	static constexpr size_t SLOT_QUEUE_SIZE = 8;
+
+	/**
+	 * @brief Queue a received frame in its slot.
+	 *
+	 * @param[in] msg - Frame contents.
+	 * @param[in] arrival - Frame arrival time.
+	 */
+	void route(std::string_view msg, rf_transport::timestamp arrival);
+
+	/**
+	 * @brief Get the queue of a slot.
+	 *
+	 * @param[in] slot - Timeslot, or tdma::contention_slot().
+	 * @return Queue index, MAX_SLOTS + 1 if the slot has none.
+	 */
+	uint32_t queue_index(uint32_t slot) const;
+
+	std::shared_ptr<rf_transport> rf_dev;
+	tdma::scheme div;
+	tdma::timing_mode mode;
+	std::atomic<int32_t> rx_offset_ms = 0;
+	std::atomic<uint64_t> dropped = 0;
+
+	// Car slots, then the contention slot
+	std::array<spsc_queue<rf_transport::frame, SLOT_QUEUE_SIZE>, MAX_SLOTS + 1>
+		queues;
+};
@@ -0,0 +1,67 @@
+/**
+ * @file include/spscqueue.hpp
+ * @brief Fixed size lock-free single producer, single consumer queue.
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+/**
+ * @brief Lock-free queue between exactly one producer and one consumer.
+ * @note push() may only be called from the producer thread and pop() only
+ * from the consumer thread.
+ *
+ * @tparam T Element type, copied in and out.
+ * @tparam CAPACITY Maximum queued elements.
+ */
+template<typename T, size_t CAPACITY>
+class spsc_queue {
+public:
+	/**
+	 * @brief Add an element.
+	 *
+	 * @param[in] item - Element to copy in.
+	 * @return False if the queue is full.
+	 */
+	bool push(const T &item) {
+		size_t cur_tail = tail.load(std::memory_order_relaxed);
+		size_t next_tail = (cur_tail + 1) % SLOTS;
+		if (next_tail == head.load(std::memory_order_acquire)) {
+			return false;
+		}
+
+		items[cur_tail] = item;
+		tail.store(next_tail, std::memory_order_release);
+		return true;
+	}
+
+	/**
+	 * @brief Take the oldest element.
+	 *
+	 * @param[out] item - Element copied out.
+	 * @return False if the queue is empty.
+	 */
+	bool pop(T &item) {
+		size_t cur_head = head.load(std::memory_order_relaxed);
+		if (cur_head == tail.load(std::memory_order_acquire)) {
+			return false;
+		}
+
+		item = items[cur_head];
+		head.store((cur_head + 1) % SLOTS, std::memory_order_release);
+		return true;
+	}
+
+private:
+	// One slot stays empty to tell full from empty
+	static constexpr size_t SLOTS = CAPACITY + 1;
+	static constexpr size_t CACHE_LINE = 64;
+
+	std::array<T, SLOTS> items = {};
+	// Written by consumer
+	alignas(CACHE_LINE) std::atomic<size_t> head = 0;
+	// Written by producer
+	alignas(CACHE_LINE) std::atomic<size_t> tail = 0;
+};
@@ -4,11 +4,27 @@
  */
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <future>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
 
-#include <driver/drf7020d20.hpp>
+#include <driver/transport.hpp>
+
+#include "airv2.hpp"
+#include "framecheck.hpp"
+#include "histogram.hpp"
+#include "slotclock.hpp"
+#include "txscheduler.hpp"
+
+class slot_mux;
 
 class tdma {
 public:
@@ -18,14 +34,124 @@ public:
 		AIR_C
 	};
 
-	struct scheme_info {
-		uint32_t frame_duration_ms;
-		uint32_t frames_per_second;
+	enum timing_mode {
+		// 50 ms slots of the first prototypes
+		LEGACY,
+		// 20 ms slots of the protocol draft
+		SPEC,
+		// SPEC slots after a control beacon slot, see beacon_slot()
+		SPEC_BEACON,
+		// SPEC_BEACON plus a check in slot, see contention_slot()
+		SPEC_DYNAMIC
 	};
 
-	tdma(const std::shared_ptr<drf7020d20> &rf_dev_in,
+	/**
+	 * @brief Slot timing of one scheme in one timing mode.
+	 * @note Instances are generated at compile time, see tdmatiming.hpp.
+	 */
+	struct timing_table {
+		std::chrono::microseconds slot_duration;
+		std::chrono::microseconds guard_interval;
+		// Beacon and car slots
+		std::chrono::microseconds frame_duration;
+		uint32_t slot_count;
+		bool has_beacon;
+		bool has_contention;
+		// Next start of a slot relative to the cycle start
+		std::chrono::nanoseconds (*next_start)(
+			uint32_t slot, std::chrono::nanoseconds into_cycle);
+		// Slot at a position in the cycle
+		uint32_t (*slot_at)(std::chrono::nanoseconds into_cycle);
+	};
+
+	struct timing_stats {
+		// Lateness of the receive window start
+		latency_histogram rx_wake;
+		// Receive window start until the frame arrived
+		latency_histogram rx_first_byte;
+		// Lateness of the transmission start
+		latency_histogram tx_wake;
+		// Time spent handing the frame to the radio
+		latency_histogram tx_write;
+	};
+
+	/**
+	 * @brief Constructor.
+	 * @note Installs check_frame() on a radio without a frame coding yet,
+	 * so corrupt frames are dropped before reaching any receiver.
+	 *
+	 * @param[in] rf_dev_in - Radio transport.
+	 * @param[in] timeslot - Timeslot.
+	 * @param[in] div - TDMA scheme.
+	 * @param[in] mode - Slot timing, must match the rest of the fleet.
+	 */
+	tdma(const std::shared_ptr<rf_transport> &rf_dev_in,
 		uint32_t timeslot,
-		scheme div);
+		scheme div,
+		timing_mode mode = LEGACY);
+
+	/**
+	 * @brief Constructor for one slot of a multiplexed radio.
+	 * @note Receives from the multiplexer queue instead of the radio.
+	 *
+	 * @param[in] mux_in - Slot multiplexer owning the radio.
+	 * @param[in] timeslot - Timeslot.
+	 */
+	tdma(const std::shared_ptr<slot_mux> &mux_in, uint32_t timeslot);
+
+	/**
+	 * @brief Destructor.
+	 * @note Drops the queued messages of the slot, their callbacks get a
+	 * failed result.
+	 */
+	~tdma();
+
+	/**
+	 * @brief Get the timing table of a scheme.
+	 *
+	 * @param[in] div - TDMA scheme.
+	 * @param[in] mode - Slot timing.
+	 * @return Timing table.
+	 */
+	static const timing_table &get_table(scheme div, timing_mode mode);
+
+	/**
+	 * @brief Get the timeslot a point in time falls in.
+	 *
+	 * @param[in] div - TDMA scheme.
+	 * @param[in] mode - Slot timing.
+	 * @param[in] time - Point in time.
+	 * @return Timeslot, slot_count() or above outside of every slot.
+	 */
+	static uint32_t slot_at(
+		scheme div, timing_mode mode, slot_clock::time_point time);
+
+	/**
+	 * @brief Get the number of timeslots in a frame.
+	 *
+	 * @param[in] div - TDMA scheme.
+	 * @return Timeslot count.
+	 */
+	static uint32_t slot_count(scheme div);
+
+	/**
+	 * @brief Get the timeslot number of the control beacon.
+	 * @note Only exists in SPEC_BEACON and SPEC_DYNAMIC timing, at the start
+	 * of every frame.
+	 *
+	 * @param[in] div - TDMA scheme.
+	 * @return Beacon timeslot, after the car timeslots.
+	 */
+	static uint32_t beacon_slot(scheme div);
+
+	/**
+	 * @brief Get the timeslot number of the check in contention slot.
+	 * @note Only exists in SPEC_DYNAMIC timing, right after the beacon.
+	 *
+	 * @param[in] div - TDMA scheme.
+	 * @return Contention timeslot, after the beacon.
+	 */
+	static uint32_t contention_slot(scheme div);
 
 	/**
 	 * @brief Transmit message synchronously.
@@ -33,10 +159,38 @@ public:
 	 * @param[in] msg - Message, must be at most 15 bytes.
 	 * @return Boolean result.
 	 */
-	bool tx_sync(const std::string &msg) const;
+	bool tx_sync(const std::string &msg);
+
+	/**
+	 * @brief Queue message for the next free occurrence of the timeslot.
+	 * @note Consecutive messages go out in consecutive frames, except
+	 * AIRv2 messages that fit into the frame still queued before them.
+	 *
+	 * @param[in] msg - Message, must be at most 15 bytes.
+	 * @param[in] deadline - Drop the message if not sent by then. Defaults
+	 * to the end of the guard interval.
+	 * @return Transmission result, false if dropped.
+	 */
+	std::future<bool> tx_async(const std::string &msg,
+		std::optional<slot_clock::time_point> deadline = std::nullopt);
+
+	/**
+	 * @brief Queue message for the next free occurrence of the timeslot.
+	 * @note Consecutive messages go out in consecutive frames, except
+	 * AIRv2 messages that fit into the frame still queued before them.
+	 *
+	 * @param[in] msg - Message, must be at most 15 bytes.
+	 * @param[in] deadline - Drop the message if not sent by then. Defaults
+	 * to the end of the guard interval.
+	 * @param[in] callback - Called from the scheduler thread with the result.
+	 */
+	void tx_async(const std::string &msg,
+		std::optional<slot_clock::time_point> deadline,
+		std::function<void(bool)> callback);
 
 	/**
 	 * @brief Transmit the current timestamp accounting for offset.
+	 * @note The timestamp is the millisecond within the slot clock cycle.
 	 *
 	 * @return The timestamp milliseconds sent.
 	 */
@@ -50,6 +204,16 @@ public:
 	 */
 	std::string rx_sync(uint32_t max_frames) const;
 
+	/**
+	 * @brief Receive message synchronously without allocating.
+	 * @note AIRv2 bundles are returned one message per call.
+	 *
+	 * @param[out] msg - Received message.
+	 * @param[in] max_frames - Maximum frames before timeout
+	 * @return True if a message was received.
+	 */
+	bool rx_sync(rf_transport::frame &msg, uint32_t max_frames) const;
+
 	/**
 	 * @brief Adjust timing for receiving.
 	 *
@@ -68,6 +232,88 @@ public:
 		tx_offset_ms = new_offset_ms;
 	}
 
+	/**
+	 * @brief Select error detection or correction for this radio.
+	 * @note Applies to every slot on the radio, see set_link_coding().
+	 * Must match the rest of the fleet. Defaults to FRAME_CRC.
+	 *
+	 * @param[in] coding - Frame coding.
+	 */
+	void set_coding(frame_coding coding);
+
+	/**
+	 * @brief Get how late the last receive window was entered.
+	 *
+	 */
+	inline std::chrono::nanoseconds get_rx_wake_error() const {
+		return std::chrono::nanoseconds(rx_wake_error_ns);
+	}
+
+	/**
+	 * @brief Get how late the last transmission started.
+	 *
+	 */
+	inline std::chrono::nanoseconds get_tx_wake_error() const {
+		return std::chrono::nanoseconds(tx_wake_error_ns);
+	}
+
+	/**
+	 * @brief Measure how far a frame's transmission started from its slot.
+	 * @note Assumes one frame of latency between sender and receiver.
+	 *
+	 * @param[in] msg - Received frame.
+	 * @return Start error, positive if the sender was late.
+	 */
+	std::chrono::nanoseconds arrival_error(
+		const rf_transport::frame &msg) const;
+
+	/**
+	 * @brief Get the start error of the last received frame.
+	 *
+	 */
+	inline std::chrono::nanoseconds get_arrival_error() const {
+		return std::chrono::nanoseconds(arrival_error_ns);
+	}
+
+	/**
+	 * @brief Get slot timing histograms.
+	 *
+	 */
+	inline const timing_stats &get_timing() const {
+		return timing;
+	}
+
+	/**
+	 * @brief Print p50/p99/max of every timing histogram.
+	 *
+	 * @param[in] out - Output stream, e.g. stdout or an open file.
+	 */
+	void print_timing(FILE *out) const;
+
+	/**
+	 * @brief Get the next start of the timeslot.
+	 *
+	 */
+	slot_clock::time_point next_start() const;
+
+	/**
+	 * @brief Get the slot timing in use.
+	 *
+	 */
+	inline const timing_table &get_timing_table() const {
+		return *table;
+	}
+
+	/**
+	 * @brief Move to another timeslot, e.g. one assigned by control.
+	 * @note Not safe while another thread transmits or receives.
+	 *
+	 * @param[in] timeslot - Timeslot.
+	 */
+	inline void set_timeslot(uint32_t timeslot) {
+		slot = timeslot;
+	}
+
 	/**
 	 * @brief get the timeslot of device
 	 */
@@ -76,17 +322,121 @@ public:
 	}
 
 private:
+	/**
+	 * @brief Find the next start of the timeslot.
+	 *
+	 * @param[in] offset_ms - Offset.
+	 * @param[in] after - Slot must start strictly after this time.
+	 * @return Slot start.
+	 */
+	slot_clock::time_point next_slot(
+		int32_t offset_ms, slot_clock::time_point after) const;
+
 	/**
 	 * @brief Sleep until the next allowed time to transmit/received.
 	 *
 	 * @param[in] offset_ms - Offset.
+	 * @return Wake-up error.
+	 */
+	std::chrono::nanoseconds sleep_until_next_slot(int32_t offset_ms) const;
+
+	/**
+	 * @brief Queue a message, sharing a queued frame if possible.
+	 * @note Timing is recorded once per frame sent.
+	 *
+	 * @param[in] msg - Message, at most 15 bytes.
+	 * @param[in] deadline - Requested deadline, if any.
+	 * @param[in] done - Called with the transmission result.
 	 */
-	void sleep_until_next_slot(int32_t offset_ms) const;
+	void submit(const std::string &msg,
+		std::optional<slot_clock::time_point> deadline,
+		std::function<void(bool)> done);
 
-	std::shared_ptr<drf7020d20> rf_dev;
+	/**
+	 * @brief Merge an AIRv2 message into the last queued frame.
+	 *
+	 * @param[in] msg - Message.
+	 * @param[in] done - Called with the transmission result.
+	 * @return True if merged, nothing else to send.
+	 */
+	bool aggregate(
+		const std::string &msg, const std::function<void(bool)> &done);
+
+	/**
+	 * @brief Split a received AIRv2 bundle, keeping the rest for later.
+	 *
+	 * @param[in,out] msg - Received frame, replaced by its first message.
+	 */
+	void unbundle(rf_transport::frame &msg) const;
+
+	/**
+	 * @brief Pick the transmit time for a new message.
+	 *
+	 * @return Slot start after any queued messages.
+	 */
+	slot_clock::time_point reserve_tx_slot();
+
+	/**
+	 * @brief Get the latest acceptable start of a transmission.
+	 *
+	 * @param[in] due - Planned start.
+	 * @param[in] deadline - Requested deadline, if any.
+	 * @return Deadline.
+	 */
+	slot_clock::time_point tx_deadline(slot_clock::time_point due,
+		std::optional<slot_clock::time_point> deadline) const;
+
+	/**
+	 * @brief Note the outcome of a scheduled transmission.
+	 *
+	 * @param[in] sent - Scheduler result.
+	 */
+	void record_tx(const tx_scheduler::result &sent) const;
+
+	/**
+	 * @brief Note the wake-up error of a receive window.
+	 *
+	 * @param[in] wake_error - Wake-up error.
+	 */
+	void record_rx_wake(std::chrono::nanoseconds wake_error) const;
+
+	/**
+	 * @brief Note timing of a received frame.
+	 *
+	 * @param[in] msg - Received frame.
+	 * @param[in] window - Receive window start.
+	 */
+	void record_rx(const rf_transport::frame &msg,
+		slot_clock::time_point window) const;
+
+	/**
+	 * @brief Receive from the multiplexer queue of this slot.
+	 *
+	 * @param[out] msg - Received message.
+	 * @param[in] max_frames - Maximum frames before timeout
+	 * @return True if a message was received.
+	 */
+	bool rx_mux(rf_transport::frame &msg, uint32_t max_frames) const;
+
+	std::shared_ptr<rf_transport> rf_dev;
+	std::shared_ptr<tx_scheduler> scheduler;
+	std::shared_ptr<slot_mux> mux = nullptr;
 	uint32_t slot;
-	scheme_info sch_info;
+	const timing_table *table;
 
 	int32_t rx_offset_ms = 0;
 	int32_t tx_offset_ms = 0;
+
+	// Last queued transmission, guarded by tx_lock
+	std::mutex tx_lock;
+	slot_clock::time_point last_tx;
+
+	// Messages of the last bundle not yet returned, in reverse
+	mutable std::array<rf_transport::frame, airv2::BUNDLE_SIZE - 1> rx_backlog;
+	mutable size_t rx_backlog_count = 0;
+
+	mutable std::atomic<int64_t> rx_wake_error_ns = 0;
+	mutable std::atomic<int64_t> tx_wake_error_ns = 0;
+	mutable std::atomic<int64_t> arrival_error_ns = 0;
+	mutable timing_stats timing;
 };
@@ -0,0 +1,193 @@
+/**
+ * @file include/tdmatiming.hpp
+ * @brief Compile-time TDMA timing tables.
+ */
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+#include "slotclock.hpp"
+#include "tdma.hpp"
+
+/**
+ * @brief Slot layout of a timing mode.
+ *
+ * @tparam MODE Timing mode.
+ */
+template<tdma::timing_mode MODE>
+struct slot_timing;
+
+/**
+ * @brief Original 50 ms slots.
+ */
+template<>
+struct slot_timing<tdma::LEGACY> {
+	static constexpr auto SLOT = std::chrono::microseconds(50000);
+	static constexpr auto GUARD = std::chrono::microseconds(37500);
+	static constexpr uint32_t BEACON_SLOTS = 0;
+	static constexpr uint32_t CONTENTION_SLOTS = 0;
+};
+
+/**
+ * @brief Protocol draft section 2.2: 12.5 ms transmission, 7.5 ms guard.
+ */
+template<>
+struct slot_timing<tdma::SPEC> {
+	static constexpr auto SLOT = std::chrono::microseconds(20000);
+	static constexpr auto GUARD = std::chrono::microseconds(7500);
+	static constexpr uint32_t BEACON_SLOTS = 0;
+	static constexpr uint32_t CONTENTION_SLOTS = 0;
+};
+
+/**
+ * @brief Spec slots after a control beacon slot opening every frame.
+ */
+template<>
+struct slot_timing<tdma::SPEC_BEACON> : slot_timing<tdma::SPEC> {
+	static constexpr uint32_t BEACON_SLOTS = 1;
+};
+
+/**
+ * @brief Beacon, then a check in contention slot, then the data slots.
+ */
+template<>
+struct slot_timing<tdma::SPEC_DYNAMIC> : slot_timing<tdma::SPEC_BEACON> {
+	static constexpr uint32_t CONTENTION_SLOTS = 1;
+};
+
+template<tdma::scheme DIV>
+inline constexpr uint32_t SCHEME_SLOTS = 0;
+template<>
+inline constexpr uint32_t SCHEME_SLOTS<tdma::AIR_A> = 4;
+template<>
+inline constexpr uint32_t SCHEME_SLOTS<tdma::AIR_B> = 8;
+template<>
+inline constexpr uint32_t SCHEME_SLOTS<tdma::AIR_C> = 16;
+
+/**
+ * @brief Slot arithmetic of one scheme, folded to constants.
+ *
+ * @tparam DIV TDMA scheme.
+ * @tparam MODE Timing mode.
+ */
+template<tdma::scheme DIV, tdma::timing_mode MODE>
+struct scheme_timing {
+	static constexpr auto SLOT = slot_timing<MODE>::SLOT;
+	static constexpr auto GUARD = slot_timing<MODE>::GUARD;
+	static constexpr uint32_t SLOTS = SCHEME_SLOTS<DIV>;
+	static constexpr uint32_t BEACON_SLOTS = slot_timing<MODE>::BEACON_SLOTS;
+	static constexpr uint32_t CONTENTION_SLOTS =
+		slot_timing<MODE>::CONTENTION_SLOTS;
+	// Control slots open the frame
+	static constexpr uint32_t HEAD_SLOTS = BEACON_SLOTS + CONTENTION_SLOTS;
+	static constexpr auto FRAME = SLOT * (HEAD_SLOTS + SLOTS);
+	static constexpr uint32_t FRAMES = slot_clock::CYCLE / FRAME;
+	// Cycle time after the last whole frame is left unused
+	static constexpr auto ACTIVE = FRAME * FRAMES;
+
+	static_assert(SLOTS > 0, "Unknown scheme");
+	static_assert(GUARD < SLOT, "Guard interval must leave time to transmit");
+	static_assert(FRAMES > 0, "Frame must fit in a cycle");
+
+	/**
+	 * @brief Find the next start of a slot.
+	 *
+	 * @param[in] slot - Timeslot, SLOTS for the beacon, SLOTS + 1 for the
+	 * contention slot.
+	 * @param[in] into_cycle - Current position in the cycle.
+	 * @return Slot start from the cycle start, a cycle or more if it falls
+	 * into the next cycle.
+	 */
+	static constexpr std::chrono::nanoseconds next_start(
+		uint32_t slot, std::chrono::nanoseconds into_cycle) {
+		int64_t frame = into_cycle / FRAME;
+		int64_t cur_pos = (into_cycle % FRAME) / SLOT;
+		int64_t pos = slot + HEAD_SLOTS;
+		if (slot == SLOTS) {
+			pos = 0;
+		} else if (slot > SLOTS) {
+			pos = BEACON_SLOTS;
+		}
+
+		// Same frame if timeslot not passed, otherwise next frame
+		if (into_cycle >= ACTIVE) {
+			frame = FRAMES;
+		} else if (cur_pos >= pos) {
+			frame++;
+		}
+
+		// If above allowed frames, go to next cycle
+		if (frame >= FRAMES) {
+			return slot_clock::CYCLE + SLOT * pos;
+		}
+
+		return FRAME * frame + SLOT * pos;
+	}
+
+	/**
+	 * @brief Get the slot at a position in the cycle.
+	 *
+	 * @param[in] into_cycle - Position in the cycle.
+	 * @return Timeslot, SLOTS + 1 in the contention slot, SLOTS in the beacon
+	 * or outside of every frame.
+	 */
+	static constexpr uint32_t slot_at(std::chrono::nanoseconds into_cycle) {
+		uint32_t pos = (into_cycle % FRAME) / SLOT;
+		if (into_cycle >= ACTIVE || pos < BEACON_SLOTS) {
+			return SLOTS;
+		}
+		if (pos < HEAD_SLOTS) {
+			return SLOTS + 1;
+		}
+
+		return pos - HEAD_SLOTS;
+	}
+};
+
+template<tdma::scheme DIV, tdma::timing_mode MODE>
+inline constexpr tdma::timing_table TIMING_TABLE = {
+	.slot_duration = scheme_timing<DIV, MODE>::SLOT,
+	.guard_interval = scheme_timing<DIV, MODE>::GUARD,
+	.frame_duration = scheme_timing<DIV, MODE>::FRAME,
+	.slot_count = scheme_timing<DIV, MODE>::SLOTS,
+	.has_beacon = scheme_timing<DIV, MODE>::BEACON_SLOTS > 0,
+	.has_contention = scheme_timing<DIV, MODE>::CONTENTION_SLOTS > 0,
+	.next_start = &scheme_timing<DIV, MODE>::next_start,
+	.slot_at = &scheme_timing<DIV, MODE>::slot_at,
+};
+
+// 20 ms spec slots make shorter frames than legacy slots: 80 ms for AIR_A,
+// and three AIR_C frames to a cycle where the legacy table fits one
+static_assert(scheme_timing<tdma::AIR_A, tdma::SPEC>::FRAME ==
+			  std::chrono::milliseconds(80));
+static_assert(scheme_timing<tdma::AIR_C, tdma::SPEC>::FRAMES == 3);
+static_assert(scheme_timing<tdma::AIR_C, tdma::LEGACY>::FRAMES == 1);
+
+// Slot 1 already passed in this frame, so the next frame
+static_assert(scheme_timing<tdma::AIR_A, tdma::SPEC>::next_start(
+				  1, std::chrono::milliseconds(25)) ==
+			  std::chrono::milliseconds(100));
+// Idle end of the cycle wraps over
+static_assert(scheme_timing<tdma::AIR_C, tdma::LEGACY>::next_start(
+				  2, std::chrono::milliseconds(900)) ==
+			  std::chrono::milliseconds(1100));
+static_assert(scheme_timing<tdma::AIR_B, tdma::SPEC>::slot_at(
+				  std::chrono::milliseconds(170)) == 0);
+// Beacon opens the frame, car slots follow
+static_assert(scheme_timing<tdma::AIR_A, tdma::SPEC_BEACON>::next_start(
+				  4, std::chrono::milliseconds(30)) ==
+			  std::chrono::milliseconds(100));
+static_assert(scheme_timing<tdma::AIR_A, tdma::SPEC_BEACON>::next_start(
+				  0, std::chrono::milliseconds(10)) ==
+			  std::chrono::milliseconds(20));
+static_assert(scheme_timing<tdma::AIR_A, tdma::SPEC_BEACON>::slot_at(
+				  std::chrono::milliseconds(105)) == 4);
+// Contention slot right after the beacon
+static_assert(scheme_timing<tdma::AIR_A, tdma::SPEC_DYNAMIC>::next_start(
+				  5, std::chrono::milliseconds(30)) ==
+			  std::chrono::milliseconds(140));
+static_assert(scheme_timing<tdma::AIR_A, tdma::SPEC_DYNAMIC>::slot_at(
+				  std::chrono::milliseconds(30)) == 5);
+static_assert(scheme_timing<tdma::AIR_A, tdma::SPEC_DYNAMIC>::slot_at(
+				  std::chrono::milliseconds(50)) == 0);
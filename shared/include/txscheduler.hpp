@@ -0,0 +1,142 @@
+/**
+ * @file include/txscheduler.hpp
+ * @brief Deadline-ordered transmit queue shared by all slots on a radio.
+ */
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <driver/transport.hpp>
+
+class tx_scheduler {
+public:
+	using clock = std::chrono::steady_clock;
+
+	struct result {
+		bool sent;
+		// How late the transmission started
+		clock::duration wake_error;
+		// Time spent in the transport transmit call
+		clock::duration write_time;
+	};
+
+	/**
+	 * @brief Constructor.
+	 *
+	 * @param[in] rf_dev_in - Radio to transmit on.
+	 */
+	tx_scheduler(const std::shared_ptr<rf_transport> &rf_dev_in);
+
+	~tx_scheduler();
+
+	/**
+	 * @brief Get the scheduler of a radio, creating it if needed.
+	 * @note Every user of the same radio shares one scheduler thread.
+	 *
+	 * @param[in] rf_dev - Radio transport.
+	 * @return Shared scheduler.
+	 */
+	static std::shared_ptr<tx_scheduler> for_transport(
+		const std::shared_ptr<rf_transport> &rf_dev);
+
+	/**
+	 * @brief Queue a frame for transmission at a given time.
+	 *
+	 * @param[in] msg - Message, at most one frame.
+	 * @param[in] due - Time to start transmitting.
+	 * @param[in] deadline - Latest acceptable start, drops the frame after.
+	 * @return Transmission result, false if dropped.
+	 */
+	std::future<bool> submit(const std::string &msg,
+		clock::time_point due,
+		std::optional<clock::time_point> deadline = std::nullopt);
+
+	/**
+	 * @brief Queue a frame for transmission at a given time.
+	 *
+	 * @param[in] msg - Message, at most one frame.
+	 * @param[in] due - Time to start transmitting.
+	 * @param[in] deadline - Latest acceptable start, drops the frame after.
+	 * @param[in] callback - Called from the scheduler thread with the result.
+	 * @param[in] owner - Tag for cancel(), nullptr for none.
+	 */
+	void submit(const std::string &msg,
+		clock::time_point due,
+		std::optional<clock::time_point> deadline,
+		std::function<void(const result &)> callback,
+		const void *owner = nullptr);
+
+	/**
+	 * @brief Change a frame still waiting in the queue.
+	 * @note Frames already handed to the radio cannot be changed.
+	 *
+	 * @param[in] due - Start time the frame was queued for.
+	 * @param[in] owner - Only frames submitted with this tag are merged into.
+	 * @param[in] merge - Updates the frame, false to leave it alone.
+	 * @param[in] callback - Also called with the result of the frame.
+	 * @return True if a queued frame was merged into.
+	 */
+	bool combine(clock::time_point due,
+		const void *owner,
+		const std::function<bool(rf_transport::frame &)> &merge,
+		const std::function<void(const result &)> &callback);
+
+	/**
+	 * @brief Drop the queued frames of an owner.
+	 * @note Waits for a frame of the owner being sent, unless called from
+	 * its callback. Dropped frames get a failed result right away, so no
+	 * callback of the owner runs after this returns.
+	 *
+	 * @param[in] owner - Tag the frames were submitted with.
+	 */
+	void cancel(const void *owner);
+
+private:
+	struct entry {
+		clock::time_point due;
+		std::optional<clock::time_point> deadline;
+		uint64_t order;
+		rf_transport::frame data;
+		std::function<void(const result &)> done;
+		const void *owner;
+	};
+
+	/**
+	 * @brief Heap order, earliest due time on top.
+	 *
+	 * @param[in] lhs - Left entry.
+	 * @param[in] rhs - Right entry.
+	 * @return True if lhs goes after rhs.
+	 */
+	static bool later(const entry &lhs, const entry &rhs);
+
+	/**
+	 * @brief Scheduler thread body.
+	 *
+	 */
+	void worker_loop();
+
+	std::shared_ptr<rf_transport> rf_dev;
+
+	// Guards queue, sending & active
+	std::mutex lock;
+	std::condition_variable cond;
+	// Min-heap on due time, FIFO among equal times
+	std::vector<entry> queue;
+	uint64_t next_order = 0;
+	// Owner of the frame out of the queue, until its callback returned
+	const void *sending = nullptr;
+	bool active = true;
+
+	std::unique_ptr<std::thread> worker;
+};
@@ -0,0 +1,150 @@
+/**
+ * @file src/arq.cpp
+ * @brief Stop-and-wait ARQ for AIRv2 sessions.
+ */
+#include "arq.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include <driver/transport.hpp>
+
+#include "airv2.hpp"
+#include "slotclock.hpp"
+#include "tdma.hpp"
+
+arq_session::arq_session(const std::shared_ptr<tdma> &tdma_in)
+	: tdma_handler(tdma_in) {}
+
+void arq_session::reset(uint8_t session_in) {
+	session = session_in;
+	tx_seq = 0;
+	rx_seq = 0;
+	last_reply.reset();
+	held.reset();
+}
+
+std::optional<airv2::frame> arq_session::check_in(
+	const std::string &msg, uint32_t tries) {
+	for (uint32_t i = 0; i < tries; i++) {
+		if (i > 0) {
+			retransmissions++;
+		}
+		transmit(msg);
+
+		// Control answers in the next occurrence of the slot
+		rf_transport::frame rx;
+		if (!tdma_handler->rx_sync(rx, 1)) {
+			continue;
+		}
+
+		auto reply = airv2::decode(rx.bytes());
+		if (reply.has_value() &&
+			airv2::get_type(*reply) == airv2::CONTROL_ID) {
+			reset(reply->session);
+			return reply;
+		}
+	}
+	return std::nullopt;
+}
+
+std::optional<airv2::frame> arq_session::request(
+	airv2::frame msg, airv2::type reply_type) {
+	msg.session = session;
+	msg.seq = ++tx_seq;
+	auto encoded = airv2::encode(msg);
+
+	for (uint32_t i = 0; i < MAX_TRIES; i++) {
+		if (i > 0) {
+			retransmissions++;
+		}
+		transmit(encoded);
+
+		rf_transport::frame rx;
+		if (!tdma_handler->rx_sync(rx, 1)) {
+			continue;
+		}
+
+		// Late replies to earlier attempts carry older sequence numbers
+		auto reply = airv2::decode(rx.bytes());
+		if (reply.has_value() && reply->session == session &&
+			reply->seq == msg.seq && airv2::get_type(*reply) == reply_type) {
+			return reply;
+		}
+	}
+	return std::nullopt;
+}
+
+void arq_session::post(airv2::frame msg) {
+	msg.session = session;
+	msg.seq = ++tx_seq;
+
+	// Queued only, the next request can share its frame
+	tdma_handler->tx_async(airv2::encode(msg));
+}
+
+std::optional<airv2::frame> arq_session::receive(uint32_t max_frames) {
+	if (held.has_value()) {
+		auto msg = *held;
+		held.reset();
+		return msg;
+	}
+
+	for (uint32_t i = 0; i < max_frames; i++) {
+		rf_transport::frame rx;
+		if (!tdma_handler->rx_sync(rx, 1) || answer_repeat(rx)) {
+			continue;
+		}
+
+		auto msg = airv2::decode(rx.bytes());
+		if (!msg.has_value() || msg->session != session) {
+			continue;
+		}
+
+		rx_seq = msg->seq;
+		last_reply.reset();
+		return msg;
+	}
+	return std::nullopt;
+}
+
+bool arq_session::answer_repeat(const rf_transport::frame &rx) {
+	bool repeat = false;
+	if (!airv2::is_airv2(rx.bytes())) {
+		// Before the first request the car can only be repeating its check in
+		repeat = rx_seq == 0;
+	} else {
+		auto msg = airv2::decode(rx.bytes());
+		repeat = msg.has_value() && msg->session == session &&
+				 (int8_t)(msg->seq - rx_seq) <= 0;
+		// Only the last request has its reply kept
+		if (repeat && msg->seq != rx_seq) {
+			repeats++;
+			return true;
+		}
+	}
+
+	if (!repeat) {
+		return false;
+	}
+
+	repeats++;
+	if (last_reply.has_value()) {
+		tdma_handler->tx_async(*last_reply);
+	}
+	return true;
+}
+
+void arq_session::reply(airv2::frame msg) {
+	msg.session = session;
+	msg.seq = rx_seq;
+	last_reply = airv2::encode(msg);
+	tdma_handler->tx_async(*last_reply);
+}
+
+void arq_session::transmit(const std::string &encoded) {
+	tdma_handler->tx_sync(encoded);
+	last_sent = slot_clock::clock::now();
+}
@@ -0,0 +1,52 @@
+/**
+ * @file src/clocksync.cpp
+ * @brief Slot clock offset and drift tracking from control feedback.
+ */
+#include "clocksync.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+#include "slotclock.hpp"
+
+clock_sync::clock_sync(double kp_in, double ki_in)
+	: kp(kp_in),
+	  ki(ki_in) {}
+
+void clock_sync::update(
+	std::chrono::nanoseconds error, slot_clock::time_point measured_at) {
+	std::lock_guard<std::mutex> guard(lock);
+
+	// Integral part, needs the time since the previous measurement
+	if (last_measurement.has_value() && measured_at > *last_measurement) {
+		auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			measured_at - *last_measurement);
+		drift += ki * (double)error.count() / (double)elapsed.count();
+		drift = std::clamp(drift, -MAX_DRIFT, MAX_DRIFT);
+		slot_clock::set_drift(-drift);
+	}
+	last_measurement = measured_at;
+
+	// Proportional part, late transmissions move slots earlier
+	auto step = std::chrono::nanoseconds((int64_t)(kp * (double)error.count()));
+	slot_clock::adjust(-step);
+	correction -= step;
+	samples++;
+}
+
+double clock_sync::get_drift_ppm() const {
+	std::lock_guard<std::mutex> guard(lock);
+	return drift * 1e6;
+}
+
+std::chrono::nanoseconds clock_sync::get_correction() const {
+	std::lock_guard<std::mutex> guard(lock);
+	return correction;
+}
+
+uint32_t clock_sync::get_samples() const {
+	std::lock_guard<std::mutex> guard(lock);
+	return samples;
+}
@@ -0,0 +1,145 @@
+/**
+ * @file src/contention.cpp
+ * @brief Check in slot requests for SPEC_DYNAMIC timing.
+ */
+#include "contention.hpp"
+
+#include <bit>
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <thread>
+
+#include <driver/transport.hpp>
+
+#include "airv2.hpp"
+#include "tdma.hpp"
+
+/**
+ * @brief Receive the next beacon.
+ *
+ * @param[in] beacon - Beacon slot.
+ * @return Beacon, std::nullopt if none arrived within a frame.
+ */
+static std::optional<airv2::frame> next_beacon(const tdma &beacon) {
+	rf_transport::frame rx_frame;
+	if (!beacon.rx_sync(rx_frame, 1)) {
+		return std::nullopt;
+	}
+
+	auto msg = airv2::decode(rx_frame.bytes());
+	if (!msg.has_value() || airv2::get_type(*msg) != airv2::BEACON) {
+		return std::nullopt;
+	}
+	return msg;
+}
+
+/**
+ * @brief Wait for the answer to a request sent in an open slot.
+ *
+ * @param[in] car_slot - Radio slot the request went out in.
+ * @param[in] nonce - Nonce of the request.
+ * @return Granted timeslot, std::nullopt if none arrived.
+ */
+static std::optional<uint32_t> await_answer(
+	const tdma &car_slot, uint8_t nonce) {
+	rf_transport::frame rx_frame;
+	if (!car_slot.rx_sync(rx_frame, 1)) {
+		return std::nullopt;
+	}
+
+	auto msg = airv2::decode(rx_frame.bytes());
+	if (!msg.has_value() || airv2::get_type(*msg) != airv2::CONTROL_ID ||
+		msg->session != 0 || msg->seq != nonce) {
+		return std::nullopt;
+	}
+	return msg->arg;
+}
+
+/**
+ * @brief Wait for a beacon granting a request sent in the contention slot.
+ *
+ * @param[in] beacon - Beacon slot.
+ * @param[in] nonce - Nonce of the request.
+ * @return Granted timeslot, std::nullopt after GRANT_FRAMES beacons.
+ */
+static std::optional<uint32_t> await_grant(const tdma &beacon, uint8_t nonce) {
+	for (uint32_t i = 0; i < GRANT_FRAMES; i++) {
+		auto msg = next_beacon(beacon);
+		if (!msg.has_value()) {
+			continue;
+		}
+
+		auto slot = airv2::get_grant(*msg, nonce);
+		if (slot.has_value()) {
+			return slot;
+		}
+	}
+	return std::nullopt;
+}
+
+std::optional<uint32_t> request_slot(
+	tdma &car_slot, const tdma &beacon, uint8_t position) {
+	static thread_local std::mt19937 rng(std::random_device{}()); // NOLINT
+	std::uniform_int_distribution<uint32_t> nonce_dist(1, 255);
+	const auto &table = beacon.get_timing_table();
+	uint32_t car_slots = (1U << table.slot_count) - 1;
+
+	// Contention slot follows the beacon, see tdma::contention_slot()
+	uint32_t contention = beacon.get_timeslot() + 1;
+	auto latest = next_beacon(beacon);
+	// Slots of the latest beacon's frame still ahead
+	uint32_t ahead = car_slots;
+	for (uint32_t attempt = 0; attempt < CONTENTION_TRIES; attempt++) {
+		uint32_t open = latest.has_value()
+							? airv2::get_open_slots(*latest) & ahead
+							: 0;
+
+		// Spread out over the open slots. The contention slot is granted
+		// from first, so only ask there without one.
+		uint32_t target = contention;
+		if (open != 0) {
+			std::uniform_int_distribution<uint32_t> choice(
+				0, (uint32_t)std::popcount(open) - 1);
+			uint32_t left = open;
+			for (uint32_t skip = choice(rng); skip > 0; skip--) {
+				left &= left - 1;
+			}
+			target = (uint32_t)std::countr_zero(left);
+		}
+
+		auto nonce = (uint8_t)nonce_dist(rng);
+		car_slot.set_timeslot(target);
+		car_slot.tx_sync(airv2::encode(airv2::make(
+			airv2::REQUEST, 0, nonce, airv2::positions(position, position))));
+
+		std::optional<uint32_t> slot;
+		if (target == contention) {
+			slot = await_grant(beacon, nonce);
+			latest.reset();
+		} else {
+			// The next beacon comes before the answer, so a lost request
+			// can be sent again later in the same frame
+			latest = next_beacon(beacon);
+			ahead = car_slots & ~((2U << target) - 1);
+			slot = await_answer(car_slot, nonce);
+		}
+		if (slot.has_value() && *slot < table.slot_count) {
+			car_slot.set_timeslot(*slot);
+			return slot;
+		}
+
+		// Collided, lost or no slot free. Ask in the frame of a fresh
+		// beacon otherwise, slots taken meanwhile hold check ins.
+		std::uniform_int_distribution<uint32_t> backoff(0, (1U << attempt) - 1);
+		auto frames = backoff(rng);
+		if (frames > 0 || !latest.has_value() ||
+			(airv2::get_open_slots(*latest) & ahead) == 0) {
+			std::this_thread::sleep_for(table.frame_duration * frames);
+			latest = next_beacon(beacon);
+			ahead = car_slots;
+		}
+	}
+
+	return std::nullopt;
+}
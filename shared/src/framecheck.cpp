@@ -0,0 +1,249 @@
+/**
+ * @file src/framecheck.cpp
+ * @brief Frame integrity checks, applied before any message parsing.
+ */
+#include "framecheck.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+
+#include <driver/transport.hpp>
+
+#include "airv2.hpp"
+#include "crc.hpp"
+#include "fec.hpp"
+
+// Message, NUL and CRC-8 must fit the frame
+static constexpr size_t MAX_SEALED_LENGTH = rf_transport::FRAME_SIZE - 2;
+// Two NULs before the parity, so one byte error cannot hide them both
+static constexpr size_t MAX_FEC_LENGTH = FEC_DATA_BYTES - 2;
+
+enum check_result {
+	// Trailer, parity or AIRv2 CRC matched
+	CHECK_PASSED,
+	// No trailer, only checked for stray bytes
+	CHECK_SKIPPED,
+	CHECK_FAILED
+};
+
+struct coded_link {
+	std::weak_ptr<rf_transport> radio;
+	frame_coding coding;
+	std::shared_ptr<std::atomic<uint64_t>> unchecked;
+};
+
+/**
+ * @brief Check a frame against its CRC trailer.
+ *
+ * @param[in] data - Frame contents.
+ * @param[in] legacy - Take short ASCII messages without a trailer.
+ * @return Check result.
+ */
+static check_result check_crc(std::span<const uint8_t> data, bool legacy);
+
+/**
+ * @brief Check a frame against its parity, fixing it if possible.
+ *
+ * @param[in,out] data - Frame contents.
+ * @return Check result.
+ */
+static check_result check_fec(std::span<uint8_t> data);
+
+/**
+ * @brief Check the printable part of an ASCII frame.
+ *
+ * @param[in] data - Frame contents.
+ * @return Message length, or std::nullopt on stray bytes.
+ */
+static std::optional<size_t> check_ascii(std::span<const uint8_t> data);
+
+/**
+ * @brief Check that a range of a frame is padding.
+ *
+ * @param[in] data - Bytes to check.
+ * @return True if all NUL.
+ */
+static bool is_padding(std::span<const uint8_t> data);
+
+/**
+ * @brief Set or look up the coding of a radio.
+ *
+ * @param[in] rf_dev - Radio transport.
+ * @param[in] coding - New coding, std::nullopt to keep the current one.
+ * @return Link in use.
+ */
+static coded_link update_link(const std::shared_ptr<rf_transport> &rf_dev,
+	std::optional<frame_coding> coding);
+
+std::string seal_frame(const std::string &msg, frame_coding coding) {
+	std::span<const uint8_t> data(
+		reinterpret_cast<const uint8_t *>(msg.data()), msg.length());
+	bool airv2_msg = airv2::is_airv2(data);
+
+	if (coding == FRAME_FEC &&
+		(airv2_msg ? msg.length() == rf_transport::FRAME_SIZE
+				   : msg.length() <= MAX_FEC_LENGTH)) {
+		std::array<uint8_t, rf_transport::FRAME_SIZE> sealed = {};
+		std::copy_n(data.begin(), std::min(data.size(), FEC_DATA_BYTES),
+			sealed.begin());
+		rs_encode(sealed);
+		return {reinterpret_cast<const char *>(sealed.data()), sealed.size()};
+	}
+
+	if (airv2_msg || msg.length() > MAX_SEALED_LENGTH) {
+		return msg;
+	}
+
+	std::string sealed = msg;
+	sealed.push_back('\0');
+	sealed.push_back((char)crc8(data));
+	return sealed;
+}
+
+bool check_frame(std::span<const uint8_t> data, bool legacy) {
+	return check_crc(data, legacy) != CHECK_FAILED;
+}
+
+bool repair_frame(std::span<uint8_t> data) {
+	return check_fec(data) != CHECK_FAILED;
+}
+
+void set_link_coding(
+	const std::shared_ptr<rf_transport> &rf_dev, frame_coding coding) {
+	update_link(rf_dev, coding);
+}
+
+frame_coding get_link_coding(const std::shared_ptr<rf_transport> &rf_dev) {
+	return update_link(rf_dev, std::nullopt).coding;
+}
+
+uint64_t get_unchecked_frames(const std::shared_ptr<rf_transport> &rf_dev) {
+	return *update_link(rf_dev, std::nullopt).unchecked;
+}
+
+check_result check_crc(std::span<const uint8_t> data, bool legacy) {
+	if (airv2::is_airv2(data)) {
+		return airv2::decode(data).has_value() ? CHECK_PASSED : CHECK_FAILED;
+	}
+
+	auto length = check_ascii(data);
+	if (!length.has_value()) {
+		return CHECK_FAILED;
+	}
+
+	// No room for a trailer
+	if (*length > MAX_SEALED_LENGTH) {
+		return is_padding(data.subspan(*length)) ? CHECK_SKIPPED
+												 : CHECK_FAILED;
+	}
+
+	if (data.size() >= *length + 2 &&
+		data[*length + 1] == crc8(data.first(*length)) &&
+		is_padding(data.subspan(*length + 2))) {
+		return CHECK_PASSED;
+	}
+
+	// AIRv1.0 peers send no trailer
+	if (legacy && is_padding(data.subspan(*length))) {
+		return CHECK_SKIPPED;
+	}
+
+	return CHECK_FAILED;
+}
+
+check_result check_fec(std::span<uint8_t> data) {
+	if (data.size() != rf_transport::FRAME_SIZE) {
+		return CHECK_FAILED;
+	}
+
+	// Long ASCII messages go out without parity: no NUL in the data part,
+	// or nothing where the parity would be
+	if (!airv2::is_airv2(data) &&
+		(std::find(data.begin(), data.begin() + FEC_DATA_BYTES, '\0') ==
+				data.begin() + FEC_DATA_BYTES ||
+			is_padding(data.subspan(FEC_DATA_BYTES)))) {
+		auto length = check_ascii(data);
+		return length.has_value() && is_padding(data.subspan(*length))
+				   ? CHECK_SKIPPED
+				   : CHECK_FAILED;
+	}
+
+	if (!rs_correct(data.first<rf_transport::FRAME_SIZE>()).has_value()) {
+		return CHECK_FAILED;
+	}
+
+	// Catch miscorrected double errors
+	if (airv2::is_airv2(data)) {
+		return airv2::decode(data).has_value() ? CHECK_PASSED : CHECK_FAILED;
+	}
+
+	auto length = check_ascii(data);
+	return length.has_value() && *length <= MAX_FEC_LENGTH &&
+				   is_padding(data.subspan(*length, FEC_DATA_BYTES - *length))
+			   ? CHECK_PASSED
+			   : CHECK_FAILED;
+}
+
+coded_link update_link(const std::shared_ptr<rf_transport> &rf_dev,
+	std::optional<frame_coding> coding) {
+	static std::mutex registry_lock;
+	static std::map<const rf_transport *, coded_link> registry; // NOLINT
+
+	std::lock_guard<std::mutex> guard(registry_lock);
+	auto known = registry.find(rf_dev.get());
+	bool fresh = known == registry.end() || known->second.radio.expired();
+	if (!fresh && !coding.has_value()) {
+		return known->second;
+	}
+
+	// Radios that are gone, their address may be reused
+	std::erase_if(registry, [](const auto &item) {
+		return item.second.radio.expired();
+	});
+
+	frame_coding applied = coding.value_or(FRAME_CRC);
+	auto unchecked = std::make_shared<std::atomic<uint64_t>>(0);
+	rf_dev->set_frame_check([applied, unchecked](std::span<uint8_t> data) {
+		auto result = applied == FRAME_FEC
+						  ? check_fec(data)
+						  : check_crc(data, applied == FRAME_CRC_LEGACY);
+		if (result == CHECK_SKIPPED) {
+			(*unchecked)++;
+		}
+		return result != CHECK_FAILED;
+	});
+
+	coded_link added = {
+		.radio = rf_dev,
+		.coding = applied,
+		.unchecked = unchecked,
+	};
+	registry[rf_dev.get()] = added;
+	return added;
+}
+
+std::optional<size_t> check_ascii(std::span<const uint8_t> data) {
+	// AIRv1.0 messages are printable ASCII
+	size_t length = 0;
+	while (length < data.size() && data[length] != '\0') {
+		if (data[length] < ' ' || data[length] > '~') {
+			return std::nullopt;
+		}
+		length++;
+	}
+
+	return length;
+}
+
+bool is_padding(std::span<const uint8_t> data) {
+	return std::all_of(data.begin(), data.end(), [](uint8_t byte) {
+		return byte == '\0';
+	});
+}
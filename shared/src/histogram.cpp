@@ -0,0 +1,85 @@
+/**
+ * @file src/histogram.cpp
+ * @brief Lock-free fixed bucket latency histogram.
+ */
+#include "histogram.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+
+void latency_histogram::add(std::chrono::nanoseconds sample) {
+	auto micros = (uint64_t)std::max<int64_t>(
+		std::chrono::duration_cast<std::chrono::microseconds>(sample).count(),
+		0);
+
+	buckets[bucket_of(micros)].fetch_add(1, std::memory_order_relaxed);
+	total.fetch_add(1, std::memory_order_relaxed);
+
+	uint64_t prev = max_us.load(std::memory_order_relaxed);
+	while (prev < micros &&
+		   !max_us.compare_exchange_weak(
+			   prev, micros, std::memory_order_relaxed)) {
+	}
+}
+
+std::chrono::microseconds latency_histogram::percentile(double fraction) const {
+	uint64_t samples = count();
+	if (samples == 0) {
+		return std::chrono::microseconds(0);
+	}
+
+	// Rank of the wanted sample, 1-based
+	auto rank = std::max<uint64_t>(
+		(uint64_t)std::ceil(fraction * (double)samples), 1);
+	uint64_t seen = 0;
+	for (uint32_t i = 0; i < BUCKETS; i++) {
+		seen += buckets[i].load(std::memory_order_relaxed);
+		if (seen >= rank) {
+			return std::chrono::microseconds(bucket_start(i));
+		}
+	}
+
+	return max();
+}
+
+void latency_histogram::print(FILE *out, const char *name) const {
+	std::fprintf(out, "%-16s n=%-6llu p50=%-8lld p99=%-8lld max=%-8lld us\n",
+		name, (unsigned long long)count(),
+		(long long)percentile(0.50).count(),
+		(long long)percentile(0.99).count(), (long long)max().count());
+}
+
+void latency_histogram::reset() {
+	for (auto &bucket : buckets) {
+		bucket.store(0, std::memory_order_relaxed);
+	}
+	total.store(0, std::memory_order_relaxed);
+	max_us.store(0, std::memory_order_relaxed);
+}
+
+uint32_t latency_histogram::bucket_of(uint64_t micros) {
+	if (micros < SUB_BUCKETS) {
+		return micros;
+	}
+
+	// Top bit picks the power of two, next bits the sub-bucket
+	uint32_t top = std::bit_width(micros) - 1;
+	uint32_t sub = (micros >> (top - SUB_BITS)) & (SUB_BUCKETS - 1);
+	return std::min(
+		SUB_BUCKETS * (top - SUB_BITS + 1) + sub, BUCKETS - 1);
+}
+
+uint64_t latency_histogram::bucket_start(uint32_t bucket) {
+	if (bucket < SUB_BUCKETS) {
+		return bucket;
+	}
+
+	uint32_t top = bucket / SUB_BUCKETS + SUB_BITS - 1;
+	uint64_t sub = bucket % SUB_BUCKETS;
+	return (SUB_BUCKETS + sub) << (top - SUB_BITS);
+}
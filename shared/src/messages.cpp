@@ -5,21 +5,44 @@
 
 #include "messages.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
 #include <fstream>
 #include <iostream>
 #include <memory>
+#include <optional>
 #include <sstream>
 #include <stdexcept>
 
 static constexpr std::string MSG_HEADER = "AIRv1.0";
+static constexpr std::string MSG_HEADER_V2 = "AIRv2.0";
 static constexpr std::string UNSUPPORTED = "UN";
 static constexpr std::string ID_FILE = "/etc/airid";
 
+// Offset byte: printable ASCII around OFFSET_ZERO, in 0.25 ms steps
+static constexpr char OFFSET_ZERO = 'O';
+static constexpr char OFFSET_MIN = '!';
+static constexpr char OFFSET_MAX = '~';
+static constexpr auto OFFSET_UNIT = std::chrono::microseconds(250);
+
 // NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
 static std::shared_ptr<std::string> control_id = nullptr;
 
-bool validate_header(const std::string &str) {
-	return str == MSG_HEADER;
+std::optional<protocol_version> validate_header(const std::string &str) {
+	if (str == MSG_HEADER) {
+		return AIRV1;
+	}
+
+	if (str == MSG_HEADER_V2) {
+		return AIRV2;
+	}
+
+	return std::nullopt;
+}
+
+const std::string &format_header(protocol_version version) {
+	return version == AIRV2 ? MSG_HEADER_V2 : MSG_HEADER;
 }
 
 bool validate_id(const std::string &str) {
@@ -53,3 +76,23 @@ const std::shared_ptr<std::string> &get_id() {
 	}
 	return control_id;
 }
+
+std::string format_offset(std::chrono::nanoseconds offset) {
+	// Round to the nearest step
+	auto steps = (offset + OFFSET_UNIT / 2) / OFFSET_UNIT;
+	if (offset < std::chrono::nanoseconds::zero()) {
+		steps = (offset - OFFSET_UNIT / 2) / OFFSET_UNIT;
+	}
+
+	auto encoded = std::clamp<int64_t>(
+		OFFSET_ZERO + steps, OFFSET_MIN, OFFSET_MAX);
+	return std::string(1, (char)encoded);
+}
+
+std::optional<std::chrono::nanoseconds> parse_offset(const std::string &str) {
+	if (str.length() != 1 || str[0] < OFFSET_MIN || str[0] > OFFSET_MAX) {
+		return std::nullopt;
+	}
+
+	return OFFSET_UNIT * (str[0] - OFFSET_ZERO);
+}
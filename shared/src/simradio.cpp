@@ -0,0 +1,171 @@
+/**
+ * @file src/simradio.cpp
+ * @brief Simulated shared RF channel for running without hardware.
+ */
+#include "simradio.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <driver/transport.hpp>
+
+// 8 data bits per byte over the air
+static constexpr uint64_t BITS_PER_FRAME = rf_transport::FRAME_SIZE * 8;
+
+sim_medium::sim_medium(uint32_t bitrate, double loss, double corruption)
+	: airtime(rf_transport::frame_airtime(bitrate)),
+	  loss_dist(loss),
+	  corrupt_dist(corruption),
+	  bit_dist(0, BITS_PER_FRAME - 1),
+	  rng(std::random_device()()) {
+	worker = std::make_unique<std::thread>([this]() {
+		worker_loop();
+	});
+}
+
+sim_medium::~sim_medium() {
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		active = false;
+	}
+	cond.notify_all();
+	worker->join();
+}
+
+sim_medium::stats sim_medium::get_stats() const {
+	return {
+		.sent = sent,
+		.delivered = delivered,
+		.collided = collided,
+		.lost = lost,
+		.corrupted = corrupted,
+	};
+}
+
+void sim_medium::join(sim_transport *station) {
+	std::lock_guard<std::mutex> guard(delivery_lock);
+	stations.push_back(station);
+}
+
+void sim_medium::leave(sim_transport *station) {
+	std::lock_guard<std::mutex> guard(delivery_lock);
+	stations.erase(std::remove(stations.begin(), stations.end(), station),
+		stations.end());
+}
+
+void sim_medium::send(const sim_transport *sender, const char *msg) {
+	std::unique_lock<std::mutex> guard(lock);
+
+	auto now = std::chrono::steady_clock::now();
+	transmission tx = {
+		.data = {},
+		.sender = sender,
+		.start = std::max(now, sender->busy_until),
+		.end = {},
+		.collided = false,
+	};
+	tx.end = tx.start + airtime;
+	std::memcpy(tx.data.data.data(), msg, rf_transport::FRAME_SIZE);
+	tx.data.length = rf_transport::FRAME_SIZE;
+	sender->busy_until = tx.end;
+
+	// Anything else on the air at the same time is lost
+	for (auto &other : in_flight) {
+		if (other.start < tx.end && tx.start < other.end) {
+			other.collided = true;
+			tx.collided = true;
+		}
+	}
+
+	// Keep ordered by end of transmission
+	auto pos = std::upper_bound(in_flight.begin(), in_flight.end(), tx,
+		[](const transmission &lhs, const transmission &rhs) {
+			return lhs.end < rhs.end;
+		});
+	in_flight.insert(pos, tx);
+	sent++;
+
+	guard.unlock();
+	cond.notify_all();
+}
+
+void sim_medium::distribute(const transmission &tx) {
+	if (tx.collided) {
+		collided++;
+		return;
+	}
+
+	std::lock_guard<std::mutex> guard(delivery_lock);
+	for (auto *station : stations) {
+		if (station == tx.sender) {
+			continue;
+		}
+
+		if (loss_dist(rng)) {
+			lost++;
+			continue;
+		}
+
+		// Flip one bit for this receiver only
+		auto received = tx.data;
+		if (corrupt_dist(rng)) {
+			uint32_t bit = bit_dist(rng);
+			received.data[bit / 8] ^= (char)(1 << bit % 8);
+			corrupted++;
+		}
+
+		// Receiver sees the frame once it is fully on the air, padding and all
+		station->deliver({received.data.data(), received.length}, tx.end);
+		delivered++;
+	}
+}
+
+void sim_medium::worker_loop() {
+	std::unique_lock<std::mutex> guard(lock);
+
+	while (active) {
+		if (in_flight.empty()) {
+			cond.wait(guard);
+			continue;
+		}
+
+		auto due = in_flight.front().end;
+		if (std::chrono::steady_clock::now() < due) {
+			cond.wait_until(guard, due);
+			continue;
+		}
+
+		transmission tx = in_flight.front();
+		in_flight.pop_front();
+
+		guard.unlock();
+		distribute(tx);
+		guard.lock();
+	}
+}
+
+sim_transport::sim_transport(const std::shared_ptr<sim_medium> &medium_in)
+	: medium(medium_in) {
+	medium->join(this);
+}
+
+sim_transport::~sim_transport() {
+	medium->leave(this);
+}
+
+bool sim_transport::transmit(const char *msg, uint32_t length) const {
+	for (uint32_t sent = 0; sent < length; sent += FRAME_SIZE) {
+		// Pad last frame
+		std::array<char, FRAME_SIZE> buffer = {};
+		std::memcpy(buffer.data(), msg + sent,
+			std::min<uint32_t>(FRAME_SIZE, length - sent));
+		medium->send(this, buffer.data());
+	}
+
+	return true;
+}
@@ -0,0 +1,154 @@
+/**
+ * @file src/slotclock.cpp
+ * @brief Monotonic clock for TDMA slot timing.
+ */
+#include "slotclock.hpp"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <mutex>
+
+struct epoch_state {
+	std::mutex lock;
+	// Epoch at ref_ns, both nanoseconds of the monotonic clock
+	int64_t base_ns;
+	int64_t ref_ns;
+	// Epoch movement per unit of elapsed time
+	double drift;
+};
+
+/**
+ * @brief Find the monotonic time of the last wall clock second boundary.
+ *
+ * @return Epoch as nanoseconds of the monotonic clock.
+ */
+static int64_t wall_epoch();
+
+/**
+ * @brief Get the shared epoch state.
+ *
+ */
+static epoch_state &shared_state();
+
+/**
+ * @brief Evaluate the epoch at a point in time.
+ * @note Caller holds the state lock.
+ *
+ * @param[in] state - Epoch state.
+ * @param[in] time_ns - Monotonic time in nanoseconds.
+ * @return Epoch in nanoseconds.
+ */
+static int64_t epoch_at(const epoch_state &state, int64_t time_ns);
+
+slot_clock::time_point slot_clock::epoch() {
+	auto &state = shared_state();
+	auto now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		clock::now().time_since_epoch())
+					  .count();
+
+	std::lock_guard<std::mutex> guard(state.lock);
+	return time_point(std::chrono::nanoseconds(epoch_at(state, now_ns)));
+}
+
+void slot_clock::adjust(clock::duration correction) {
+	auto &state = shared_state();
+	std::lock_guard<std::mutex> guard(state.lock);
+	state.base_ns +=
+		std::chrono::duration_cast<std::chrono::nanoseconds>(correction)
+			.count();
+}
+
+void slot_clock::set_drift(double rate) {
+	auto &state = shared_state();
+	auto now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		clock::now().time_since_epoch())
+					  .count();
+
+	// Keep the epoch continuous at the change
+	std::lock_guard<std::mutex> guard(state.lock);
+	state.base_ns = epoch_at(state, now_ns);
+	state.ref_ns = now_ns;
+	state.drift = rate;
+}
+
+double slot_clock::get_drift() {
+	auto &state = shared_state();
+	std::lock_guard<std::mutex> guard(state.lock);
+	return state.drift;
+}
+
+void slot_clock::resync() {
+	auto &state = shared_state();
+	auto now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		clock::now().time_since_epoch())
+					  .count();
+	auto wall_ns = wall_epoch();
+
+	std::lock_guard<std::mutex> guard(state.lock);
+	state.base_ns = wall_ns;
+	state.ref_ns = now_ns;
+}
+
+slot_clock::time_point slot_clock::cycle_start(time_point time) {
+	auto &state = shared_state();
+	auto time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		time.time_since_epoch())
+					   .count();
+
+	int64_t start_ns = 0;
+	{
+		std::lock_guard<std::mutex> guard(state.lock);
+		start_ns = epoch_at(state, time_ns);
+	}
+
+	// Floor also rounds down before the epoch
+	auto start = time_point(std::chrono::nanoseconds(start_ns));
+	return start + std::chrono::floor<std::chrono::seconds>(time - start);
+}
+
+slot_clock::clock::duration slot_clock::cycle_offset(time_point time) {
+	return time - cycle_start(time);
+}
+
+slot_clock::clock::duration slot_clock::sleep_until(time_point deadline) {
+	auto since_boot = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		deadline.time_since_epoch());
+	timespec wake = {
+		.tv_sec = (time_t)(since_boot.count() / 1000000000),
+		.tv_nsec = (long)(since_boot.count() % 1000000000),
+	};
+
+	// Absolute deadline, so restarting after a signal loses nothing
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, nullptr) ==
+		   EINTR) {
+	}
+
+	return clock::now() - deadline;
+}
+
+int64_t wall_epoch() {
+	auto wall = std::chrono::system_clock::now();
+	auto mono = slot_clock::clock::now();
+
+	auto into_second = wall - std::chrono::floor<std::chrono::seconds>(wall);
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		(mono - into_second).time_since_epoch())
+		.count();
+}
+
+epoch_state &shared_state() {
+	static epoch_state state = {
+		.lock = {},
+		.base_ns = wall_epoch(),
+		.ref_ns = 0,
+		.drift = 0.0,
+	};
+	return state;
+}
+
+int64_t epoch_at(const epoch_state &state, int64_t time_ns) {
+	return state.base_ns +
+		   (int64_t)(state.drift * (double)(time_ns - state.ref_ns));
+}
@@ -0,0 +1,95 @@
+/**
+ * @file src/slotmux.cpp
+ * @brief Routes received frames of a shared radio to per-slot queues.
+ */
+#include "slotmux.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <string_view>
+
+#include <driver/transport.hpp>
+
+#include "airv2.hpp"
+#include "framecheck.hpp"
+#include "tdma.hpp"
+
+slot_mux::slot_mux(const std::shared_ptr<rf_transport> &rf_dev_in,
+	tdma::scheme div_in,
+	tdma::timing_mode mode_in)
+	: rf_dev(rf_dev_in),
+	  div(div_in),
+	  mode(mode_in) {
+	get_link_coding(rf_dev);
+	rf_dev->set_receive_callback(
+		[this](std::string_view msg, rf_transport::timestamp arrival) {
+			route(msg, arrival);
+		});
+	rf_dev->reactor_on();
+}
+
+slot_mux::~slot_mux() {
+	rf_dev->set_receive_callback(nullptr);
+}
+
+void slot_mux::set_coding(frame_coding coding) {
+	set_link_coding(rf_dev, coding);
+}
+
+frame_coding slot_mux::get_coding() const {
+	return get_link_coding(rf_dev);
+}
+
+bool slot_mux::pop(uint32_t slot, rf_transport::frame &msg) {
+	uint32_t index = queue_index(slot);
+	if (index >= queues.size()) {
+		return false;
+	}
+
+	return queues[index].pop(msg);
+}
+
+uint32_t slot_mux::slot_at(rf_transport::timestamp arrival) const {
+	return tdma::slot_at(
+		div, mode, arrival - std::chrono::milliseconds(rx_offset_ms));
+}
+
+void slot_mux::route(std::string_view msg, rf_transport::timestamp arrival) {
+	uint32_t index = queue_index(slot_at(arrival));
+
+	// Cars may ask for a slot in any open slot, the allocator answers all
+	auto bytes = std::span(
+		reinterpret_cast<const uint8_t *>(msg.data()), msg.size());
+	if (index < MAX_SLOTS && tdma::get_table(div, mode).has_contention &&
+		airv2::is_slot_request(bytes)) {
+		index = queue_index(tdma::contention_slot(div));
+	}
+
+	if (index >= queues.size()) {
+		dropped++;
+		return;
+	}
+
+	rf_transport::frame received;
+	std::memcpy(received.data.data(), msg.data(), msg.size());
+	received.length = (uint8_t)msg.size();
+	received.arrival = arrival;
+	if (!queues[index].push(received)) {
+		dropped++;
+	}
+}
+
+uint32_t slot_mux::queue_index(uint32_t slot) const {
+	if (slot < tdma::slot_count(div)) {
+		return slot;
+	}
+
+	if (slot == tdma::contention_slot(div) &&
+		tdma::get_table(div, mode).has_contention) {
+		return MAX_SLOTS;
+	}
+	return MAX_SLOTS + 1;
+}
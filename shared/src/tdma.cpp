@@ -4,102 +4,367 @@
  */
 #include "tdma.hpp"
 
+#include <algorithm>
 #include <chrono>
 #include <cstdint>
 #include <cstdio>
-#include <map>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
 #include <string>
 #include <thread>
 
-#include <driver/drf7020d20.hpp>
+#include <driver/transport.hpp>
 
+#include "airv2.hpp"
+#include "framecheck.hpp"
+#include "slotclock.hpp"
+#include "slotmux.hpp"
+#include "tdmatiming.hpp"
+#include "txscheduler.hpp"
 #include "utils.hpp"
 
-static constexpr uint32_t TIMESLOT_DURATION_MS = 50;
-static constexpr auto TIMESLOT_DURATION =
-	std::chrono::milliseconds(TIMESLOT_DURATION_MS);
+// Module to host transfer of a whole frame, 10 bits a byte at the 9600 baud
+// the demos configure, plus reactor wake-up
+static constexpr auto RX_UART_MARGIN =
+	rf_transport::frame_airtime(9600 * 8 / 10) + std::chrono::milliseconds(2);
 
-static constexpr uint32_t A_FRAME_DUR = TIMESLOT_DURATION_MS * 4;
-static constexpr uint32_t B_FRAME_DUR = TIMESLOT_DURATION_MS * 8;
-static constexpr uint32_t C_FRAME_DUR = TIMESLOT_DURATION_MS * 16;
+// Indexed by timing mode, then scheme
+static constexpr tdma::timing_table TIMING_TABLES[4][3] = {
+	{
+		TIMING_TABLE<tdma::AIR_A, tdma::LEGACY>,
+		TIMING_TABLE<tdma::AIR_B, tdma::LEGACY>,
+		TIMING_TABLE<tdma::AIR_C, tdma::LEGACY>,
+	},
+	{
+		TIMING_TABLE<tdma::AIR_A, tdma::SPEC>,
+		TIMING_TABLE<tdma::AIR_B, tdma::SPEC>,
+		TIMING_TABLE<tdma::AIR_C, tdma::SPEC>,
+	},
+	{
+		TIMING_TABLE<tdma::AIR_A, tdma::SPEC_BEACON>,
+		TIMING_TABLE<tdma::AIR_B, tdma::SPEC_BEACON>,
+		TIMING_TABLE<tdma::AIR_C, tdma::SPEC_BEACON>,
+	},
+	{
+		TIMING_TABLE<tdma::AIR_A, tdma::SPEC_DYNAMIC>,
+		TIMING_TABLE<tdma::AIR_B, tdma::SPEC_DYNAMIC>,
+		TIMING_TABLE<tdma::AIR_C, tdma::SPEC_DYNAMIC>,
+	},
+};
 
-static constexpr uint32_t A_FRAMES_PER_SEC = 1000 / A_FRAME_DUR;
-static constexpr uint32_t B_FRAMES_PER_SEC = 1000 / B_FRAME_DUR;
-static constexpr uint32_t C_FRAMES_PER_SEC = 1000 / C_FRAME_DUR;
-
-static const std::map<tdma::scheme, tdma::scheme_info> SCHEME_MAP = {
-	{tdma::AIR_A, {.frame_duration_ms = A_FRAME_DUR,
-					  .frames_per_second = A_FRAMES_PER_SEC}},
-	{tdma::AIR_B, {.frame_duration_ms = B_FRAME_DUR,
-					  .frames_per_second = B_FRAMES_PER_SEC}},
-	{tdma::AIR_C, {.frame_duration_ms = C_FRAME_DUR,
-					  .frames_per_second = C_FRAMES_PER_SEC}}};
-
-tdma::tdma(
-	const std::shared_ptr<drf7020d20> &rf_dev_in, uint32_t timeslot, scheme div)
+tdma::tdma(const std::shared_ptr<rf_transport> &rf_dev_in,
+	uint32_t timeslot,
+	scheme div,
+	timing_mode mode)
 	: rf_dev(rf_dev_in),
+	  scheduler(tx_scheduler::for_transport(rf_dev)),
 	  slot(timeslot),
-	  sch_info(SCHEME_MAP.at(div)) {
-	rf_dev->rejecter_on();
+	  table(&get_table(div, mode)) {
+	// Leaves a coding selected earlier on the radio alone
+	get_link_coding(rf_dev);
+	rf_dev->reactor_on();
 }
 
-bool tdma::tx_sync(const std::string &msg) const {
-	if (msg.length() > 15) {
-		return false;
+tdma::tdma(const std::shared_ptr<slot_mux> &mux_in, uint32_t timeslot)
+	: tdma(mux_in->get_transport(),
+		  timeslot,
+		  mux_in->get_scheme(),
+		  mux_in->get_mode()) {
+	mux = mux_in;
+}
+
+tdma::~tdma() {
+	// Queued callbacks record into this object
+	scheduler->cancel(this);
+}
+
+const tdma::timing_table &tdma::get_table(scheme div, timing_mode mode) {
+	return TIMING_TABLES[mode][div];
+}
+
+uint32_t tdma::slot_at(
+	scheme div, timing_mode mode, slot_clock::time_point time) {
+	return get_table(div, mode).slot_at(time - slot_clock::cycle_start(time));
+}
+
+uint32_t tdma::slot_count(scheme div) {
+	return get_table(div, LEGACY).slot_count;
+}
+
+uint32_t tdma::beacon_slot(scheme div) {
+	return slot_count(div);
+}
+
+uint32_t tdma::contention_slot(scheme div) {
+	return slot_count(div) + 1;
+}
+
+bool tdma::tx_sync(const std::string &msg) {
+	return tx_async(msg).get();
+}
+
+std::future<bool> tdma::tx_async(const std::string &msg,
+	std::optional<slot_clock::time_point> deadline) {
+	if (msg.length() > rf_transport::FRAME_SIZE) {
+		std::promise<bool> rejected;
+		rejected.set_value(false);
+		return rejected.get_future();
 	}
 
-	sleep_until_next_slot(tx_offset_ms);
-	return rf_dev->transmit(msg.data(), 15);
+	auto result = std::make_shared<std::promise<bool>>();
+	auto future = result->get_future();
+	submit(msg, deadline, [result](bool sent) {
+		result->set_value(sent);
+	});
+
+	return future;
+}
+
+void tdma::tx_async(const std::string &msg,
+	std::optional<slot_clock::time_point> deadline,
+	std::function<void(bool)> callback) {
+	if (msg.length() > rf_transport::FRAME_SIZE) {
+		callback(false);
+		return;
+	}
+
+	submit(msg, deadline, std::move(callback));
+}
+
+void tdma::set_coding(frame_coding coding) {
+	set_link_coding(rf_dev, coding);
 }
 
 int32_t tdma::tx_ts_sync() const {
-	sleep_until_next_slot(tx_offset_ms);
-	auto sent_ts = generate_ms() - tx_offset_ms;
+	auto wake_error = sleep_until_next_slot(tx_offset_ms);
+
+	// Position in the slot cycle, the wall clock moves independently
+	auto cycle_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+		slot_clock::cycle_offset(slot_clock::clock::now()));
+	auto sent_ts = (int32_t)cycle_ms.count() - tx_offset_ms;
 	char buffer[16];
 	std::snprintf(buffer, 16, "%15u", sent_ts);
-	rf_dev->transmit(buffer, 15);
+
+	auto write_start = slot_clock::clock::now();
+	bool sent = rf_dev->transmit(buffer, 15);
+	record_tx({
+		.sent = sent,
+		.wake_error = wake_error,
+		.write_time = slot_clock::clock::now() - write_start,
+	});
 	return sent_ts;
 }
 
 std::string tdma::rx_sync(uint32_t max_frames) const {
+	rf_transport::frame msg;
+	if (!rx_sync(msg, max_frames)) {
+		return "";
+	}
+
+	return std::string(msg.view());
+}
+
+bool tdma::rx_sync(rf_transport::frame &msg, uint32_t max_frames) const {
+	if (rx_backlog_count > 0) {
+		msg = rx_backlog[--rx_backlog_count];
+		return true;
+	}
+
+	if (mux != nullptr) {
+		return rx_mux(msg, max_frames);
+	}
+
+	for (uint32_t i = 0; i < max_frames; i++) {
+		auto start = next_slot(rx_offset_ms, slot_clock::clock::now());
+		record_rx_wake(slot_clock::sleep_until(start));
+		auto window = std::chrono::duration_cast<std::chrono::milliseconds>(
+			table->slot_duration);
+		if (rf_dev->receive(msg, window) && !msg.view().empty()) {
+			record_rx(msg, start);
+			unbundle(msg);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool tdma::rx_mux(rf_transport::frame &msg, uint32_t max_frames) const {
+	// A frame is queued once its last byte came over the UART, which is
+	// after its airtime and usually after the slot is over
+	auto settle = rf_dev->get_frame_airtime() + RX_UART_MARGIN;
+	auto listening = next_slot(rx_offset_ms, slot_clock::clock::now());
 	for (uint32_t i = 0; i < max_frames; i++) {
-		sleep_until_next_slot(rx_offset_ms);
-		std::string res = rf_dev->receive(TIMESLOT_DURATION);
+		auto start = next_slot(rx_offset_ms, slot_clock::clock::now());
 
-		if (!res.empty()) {
-			return res;
+		auto end = start + table->slot_duration;
+		record_rx_wake(slot_clock::sleep_until(end + settle));
+		while (mux->pop(slot, msg)) {
+			// Left over from before we were listening
+			if (msg.arrival < listening || msg.view().empty()) {
+				continue;
+			}
+
+			record_rx(msg, start);
+			unbundle(msg);
+			return true;
 		}
 	}
 
-	return "";
+	return false;
+}
+
+void tdma::submit(const std::string &msg,
+	std::optional<slot_clock::time_point> deadline,
+	std::function<void(bool)> done) {
+	if (aggregate(msg, done)) {
+		return;
+	}
+
+	// Merged messages only report back, the frame is timed once
+	auto due = reserve_tx_slot();
+	auto sealed = seal_frame(msg, get_link_coding(rf_dev));
+	scheduler->submit(sealed, due, tx_deadline(due, deadline),
+		[this, done = std::move(done)](const tx_scheduler::result &sent) {
+			record_tx(sent);
+			done(sent.sent);
+		},
+		this);
 }
 
-void tdma::sleep_until_next_slot(int32_t offset_ms) const {
-	auto timestamp = std::chrono::system_clock::now();
-	auto timestamp_adj = timestamp - std::chrono::milliseconds(offset_ms);
-	auto ms_part = timestamp_adj.time_since_epoch().count() / 1000000 % 1000;
+bool tdma::aggregate(
+	const std::string &msg, const std::function<void(bool)> &done) {
+	auto next = airv2::decode(std::span(
+		reinterpret_cast<const uint8_t *>(msg.data()), msg.length()));
+	if (!next.has_value() || !airv2::can_bundle(*next)) {
+		return false;
+	}
+
+	// Messages stay in order, so only the last reserved frame can take more
+	std::lock_guard<std::mutex> guard(tx_lock);
+	if (last_tx <= slot_clock::clock::now()) {
+		return false;
+	}
+
+	auto coding = get_link_coding(rf_dev);
+	return scheduler->combine(
+		last_tx,
+		this,
+		[&next, coding](rf_transport::frame &queued) {
+			auto first = airv2::decode(queued.bytes());
+			if (!first.has_value()) {
+				return false;
+			}
+
+			auto both = airv2::bundle(*first, *next);
+			if (!both.has_value()) {
+				return false;
+			}
 
-	// Current position
-	uint32_t cur_frame = ms_part / sch_info.frame_duration_ms;
-	uint32_t cur_slot =
-		(ms_part % sch_info.frame_duration_ms) / TIMESLOT_DURATION_MS;
+			auto sealed = seal_frame(airv2::encode(*both), coding);
+			std::memcpy(queued.data.data(), sealed.data(), sealed.length());
+			queued.length = (uint8_t)sealed.length();
+			return true;
+		},
+		[done](const tx_scheduler::result &sent) {
+			done(sent.sent);
+		});
+}
 
-	// Same frame if timeslot not passed, otherwise next frame
-	uint32_t send_frame = (cur_slot >= slot) ? cur_frame + 1 : cur_frame;
+void tdma::unbundle(rf_transport::frame &msg) const {
+	auto bundle = airv2::decode(msg.bytes());
+	std::array<airv2::frame, airv2::BUNDLE_SIZE> parts = {};
+	size_t count = bundle.has_value() ? airv2::unbundle(*bundle, parts) : 0;
+	if (count == 0) {
+		return;
+	}
 
-	// If above allowed frames, go to next second
-	auto second = (send_frame >= sch_info.frames_per_second)
-					  ? std::chrono::ceil<std::chrono::seconds>(timestamp_adj)
-					  : std::chrono::floor<std::chrono::seconds>(timestamp_adj);
-	if (send_frame >= sch_info.frames_per_second) {
-		send_frame = 0;
+	// Parts keep the arrival time of the bundle
+	auto as_frame = [&msg](const airv2::frame &part) {
+		std::array<uint8_t, rf_transport::FRAME_SIZE> data = {};
+		airv2::encode(part, data);
+		rf_transport::frame split = msg;
+		std::memcpy(split.data.data(), data.data(), data.size());
+		split.length = (uint8_t)data.size();
+		return split;
+	};
+	for (size_t i = count - 1; i > 0; i--) {
+		rx_backlog[rx_backlog_count++] = as_frame(parts[i]);
 	}
+	msg = as_frame(parts[0]);
+}
+
+slot_clock::time_point tdma::next_start() const {
+	return next_slot(tx_offset_ms, slot_clock::clock::now());
+}
 
-	// Calculate offset from second start
-	auto ms_desired = std::chrono::milliseconds(
-		(int32_t)(send_frame * sch_info.frame_duration_ms +
-				  slot * TIMESLOT_DURATION_MS) +
-		offset_ms);
+slot_clock::time_point tdma::next_slot(
+	int32_t offset_ms, slot_clock::time_point after) const {
+	auto timestamp_adj = after - std::chrono::milliseconds(offset_ms);
+	auto cycle = slot_clock::cycle_start(timestamp_adj);
+
+	return cycle + table->next_start(slot, timestamp_adj - cycle) +
+		   std::chrono::milliseconds(offset_ms);
+}
+
+std::chrono::nanoseconds tdma::sleep_until_next_slot(int32_t offset_ms) const {
+	return slot_clock::sleep_until(
+		next_slot(offset_ms, slot_clock::clock::now()));
+}
+
+slot_clock::time_point tdma::reserve_tx_slot() {
+	std::lock_guard<std::mutex> guard(tx_lock);
+	last_tx =
+		next_slot(tx_offset_ms, std::max(slot_clock::clock::now(), last_tx));
+	return last_tx;
+}
+
+slot_clock::time_point tdma::tx_deadline(slot_clock::time_point due,
+	std::optional<slot_clock::time_point> deadline) const {
+	if (deadline.has_value()) {
+		return *deadline;
+	}
+
+	// Starting any later runs into the next slot
+	return due + table->guard_interval;
+}
+
+std::chrono::nanoseconds tdma::arrival_error(
+	const rf_transport::frame &msg) const {
+	// Frames arrive one airtime after their transmission started
+	auto sent = msg.arrival - rf_dev->get_frame_airtime();
+
+	// Nearest start of our slot, early or late
+	auto start = next_slot(0, sent - table->slot_duration / 2);
+	return sent - start;
+}
+
+void tdma::print_timing(FILE *out) const {
+	std::fprintf(out, "Slot %u timing:\n", slot);
+	timing.rx_wake.print(out, "RX wake-up");
+	timing.rx_first_byte.print(out, "RX first byte");
+	timing.tx_wake.print(out, "TX wake-up");
+	timing.tx_write.print(out, "TX write");
+}
+
+void tdma::record_tx(const tx_scheduler::result &sent) const {
+	tx_wake_error_ns = sent.wake_error.count();
+	timing.tx_wake.add(sent.wake_error);
+	timing.tx_write.add(sent.write_time);
+}
+
+void tdma::record_rx_wake(std::chrono::nanoseconds wake_error) const {
+	rx_wake_error_ns = wake_error.count();
+	timing.rx_wake.add(wake_error);
+}
 
-	std::this_thread::sleep_until(second + ms_desired);
+void tdma::record_rx(
+	const rf_transport::frame &msg, slot_clock::time_point window) const {
+	timing.rx_first_byte.add(msg.arrival - window);
+	arrival_error_ns = arrival_error(msg).count();
 }
@@ -0,0 +1,205 @@
+/**
+ * @file src/txscheduler.cpp
+ * @brief Deadline-ordered transmit queue shared by all slots on a radio.
+ */
+#include "txscheduler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+#include <driver/transport.hpp>
+
+tx_scheduler::tx_scheduler(const std::shared_ptr<rf_transport> &rf_dev_in)
+	: rf_dev(rf_dev_in) {
+	worker = std::make_unique<std::thread>([this]() {
+		worker_loop();
+	});
+}
+
+tx_scheduler::~tx_scheduler() {
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		active = false;
+	}
+	cond.notify_all();
+	worker->join();
+
+	// Fail everything left over
+	for (auto &pending : queue) {
+		pending.done({.sent = false, .wake_error = {}, .write_time = {}});
+	}
+}
+
+std::shared_ptr<tx_scheduler> tx_scheduler::for_transport(
+	const std::shared_ptr<rf_transport> &rf_dev) {
+	static std::mutex registry_lock;
+	static std::map<const rf_transport *, std::weak_ptr<tx_scheduler>>
+		registry; // NOLINT
+
+	std::lock_guard<std::mutex> guard(registry_lock);
+
+	// Radios that are gone, their address may be reused
+	std::erase_if(registry, [](const auto &item) {
+		return item.second.expired();
+	});
+
+	auto scheduler = registry[rf_dev.get()].lock();
+	if (scheduler == nullptr) {
+		scheduler = std::make_shared<tx_scheduler>(rf_dev);
+		registry[rf_dev.get()] = scheduler;
+	}
+
+	return scheduler;
+}
+
+std::future<bool> tx_scheduler::submit(const std::string &msg,
+	clock::time_point due,
+	std::optional<clock::time_point> deadline) {
+	auto result = std::make_shared<std::promise<bool>>();
+	auto future = result->get_future();
+	submit(msg, due, deadline, [result](const tx_scheduler::result &sent) {
+		result->set_value(sent.sent);
+	});
+
+	return future;
+}
+
+void tx_scheduler::submit(const std::string &msg,
+	clock::time_point due,
+	std::optional<clock::time_point> deadline,
+	std::function<void(const result &)> callback,
+	const void *owner) {
+	if (msg.length() > rf_transport::FRAME_SIZE) {
+		callback({.sent = false, .wake_error = {}, .write_time = {}});
+		return;
+	}
+
+	entry pending = {
+		.due = due,
+		.deadline = deadline,
+		.order = 0,
+		.data = {},
+		.done = std::move(callback),
+		.owner = owner,
+	};
+	std::memcpy(pending.data.data.data(), msg.data(), msg.length());
+	pending.data.length = (uint8_t)msg.length();
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		pending.order = next_order++;
+		queue.push_back(std::move(pending));
+		std::push_heap(queue.begin(), queue.end(), later);
+	}
+	cond.notify_all();
+}
+
+bool tx_scheduler::combine(clock::time_point due,
+	const void *owner,
+	const std::function<bool(rf_transport::frame &)> &merge,
+	const std::function<void(const result &)> &callback) {
+	std::lock_guard<std::mutex> guard(lock);
+
+	// Latest frame for that time, so messages stay in order
+	entry *queued = nullptr;
+	for (auto &pending : queue) {
+		if (pending.due == due && pending.owner == owner &&
+			(queued == nullptr || pending.order > queued->order)) {
+			queued = &pending;
+		}
+	}
+	if (queued == nullptr || !merge(queued->data)) {
+		return false;
+	}
+
+	queued->done = [first = std::move(queued->done), callback](
+					   const result &sent) {
+		first(sent);
+		callback(sent);
+	};
+	return true;
+}
+
+void tx_scheduler::cancel(const void *owner) {
+	std::vector<entry> dropped;
+	{
+		std::unique_lock<std::mutex> guard(lock);
+		if (std::this_thread::get_id() != worker->get_id()) {
+			cond.wait(guard, [this, owner]() {
+				return sending != owner;
+			});
+		}
+
+		auto kept = std::partition(
+			queue.begin(), queue.end(), [owner](const entry &pending) {
+				return pending.owner != owner;
+			});
+		std::move(kept, queue.end(), std::back_inserter(dropped));
+		queue.erase(kept, queue.end());
+		std::make_heap(queue.begin(), queue.end(), later);
+	}
+
+	for (auto &pending : dropped) {
+		pending.done({.sent = false, .wake_error = {}, .write_time = {}});
+	}
+}
+
+void tx_scheduler::worker_loop() {
+	std::unique_lock<std::mutex> guard(lock);
+
+	while (active) {
+		if (queue.empty()) {
+			cond.wait(guard);
+			continue;
+		}
+
+		// Absolute monotonic wait, re-checked in case an earlier frame arrived
+		auto due = queue.front().due;
+		if (clock::now() < due) {
+			cond.wait_until(guard, due);
+			continue;
+		}
+
+		std::pop_heap(queue.begin(), queue.end(), later);
+		entry pending = std::move(queue.back());
+		queue.pop_back();
+		sending = pending.owner;
+
+		guard.unlock();
+		auto now = clock::now();
+		result sent = {
+			.sent = false,
+			.wake_error = now - pending.due,
+			.write_time = {},
+		};
+		if (!pending.deadline.has_value() || now <= *pending.deadline) {
+			sent.sent = rf_dev->transmit(
+				pending.data.data.data(), pending.data.length);
+			sent.write_time = clock::now() - now;
+		}
+		pending.done(sent);
+		guard.lock();
+
+		// Wakes cancel() waiting for this frame
+		sending = nullptr;
+		cond.notify_all();
+	}
+}
+
+bool tx_scheduler::later(const entry &lhs, const entry &rhs) {
+	if (lhs.due != rhs.due) {
+		return lhs.due > rhs.due;
+	}
+
+	return lhs.order > rhs.order;
+}